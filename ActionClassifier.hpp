@@ -0,0 +1,227 @@
+#ifndef ACTIONCLASSIFIER_HPP
+#define ACTIONCLASSIFIER_HPP
+
+#include "BodyFeatures.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+enum ActionClass
+{
+    ACTION_STANDING = 0,
+    ACTION_WALKING,
+    ACTION_SITTING,
+    ACTION_LYING,
+    ACTION_FALLING,
+
+    ACTION_COUNT
+};
+
+using ActionProbabilities = std::array<float, ACTION_COUNT>;
+
+inline const char* action_name(int action)
+{
+    switch (action) {
+    case ACTION_STANDING:
+        return "standing";
+    case ACTION_WALKING:
+        return "walking";
+    case ACTION_SITTING:
+        return "sitting";
+    case ACTION_LYING:
+        return "lying";
+    case ACTION_FALLING:
+        return "falling";
+    default:
+        return "unknown";
+    }
+}
+
+// Streaming action classifier over the per-body feature vectors.
+//
+// Each body owns one circular buffer of its last `window` feature vectors.
+// Every stage reads that same buffer: pooled statistics are running sums
+// (add the newest frame, retire the oldest) and the temporal convolutions
+// only touch their last few taps, so the cost per frame does not depend on
+// the window length.
+class ActionClassifier
+{
+public:
+    explicit ActionClassifier(int window = 60, int dropTaps = 15)
+        : window_(std::max(window, 2)),
+          dropTaps_(std::max(2, std::min(dropTaps, window_)))
+    {
+        for (auto& track : tracks_)
+        {
+            track.ring.assign(window_, BodyFeatureVector());
+        }
+    }
+
+    // Consumes this frame's feature vector of one body and returns its
+    // class probabilities.
+    const ActionProbabilities& update(astra_body_id_t id, const BodyFeatureVector& features)
+    {
+        Track& track = track_for(id);
+
+        // Retire the oldest frame once the window is full, then add the newest.
+        BodyFeatureVector& slot = track.ring[track.head];
+        if (track.count == window_)
+        {
+            for (int f = 0; f < FEATURE_COUNT; f++)
+            {
+                track.sum[f] -= slot[f];
+                track.sumSq[f] -= slot[f] * slot[f];
+            }
+        }
+        else
+        {
+            track.count++;
+        }
+        slot = features;
+        for (int f = 0; f < FEATURE_COUNT; f++)
+        {
+            track.sum[f] += slot[f];
+            track.sumSq[f] += slot[f] * slot[f];
+        }
+        track.head = (track.head + 1) % window_;
+        track.seen = true;
+
+        // Running float sums drift over hours; rebuild them now and then.
+        if (++track.sinceRebuild >= 16 * window_)
+        {
+            rebuild_sums(track);
+        }
+
+        score(track);
+        return track.probabilities;
+    }
+
+    // Marks the start of a frame; bodies not updated since the previous
+    // call are forgotten.
+    void begin_frame()
+    {
+        for (auto& track : tracks_)
+        {
+            if (!track.seen) { track.id = ASTRA_INVALID_BODY_ID; }
+            track.seen = false;
+        }
+    }
+
+private:
+    struct Track
+    {
+        astra_body_id_t id{ ASTRA_INVALID_BODY_ID };
+        bool seen{ false };
+        std::vector<BodyFeatureVector> ring;
+        int head{ 0 };
+        int count{ 0 };
+        int sinceRebuild{ 0 };
+        std::array<float, FEATURE_COUNT> sum;
+        std::array<float, FEATURE_COUNT> sumSq;
+        ActionProbabilities probabilities;
+    };
+
+    Track& track_for(astra_body_id_t id)
+    {
+        Track* freeTrack = nullptr;
+        for (auto& track : tracks_)
+        {
+            if (track.id == id) { return track; }
+            if (track.id == ASTRA_INVALID_BODY_ID && freeTrack == nullptr) { freeTrack = &track; }
+        }
+        if (freeTrack == nullptr) { freeTrack = &tracks_[0]; }
+
+        Track& track = *freeTrack;
+        track.id = id;
+        track.head = 0;
+        track.count = 0;
+        track.sinceRebuild = 0;
+        track.sum.fill(0.f);
+        track.sumSq.fill(0.f);
+        return track;
+    }
+
+    void rebuild_sums(Track& track) const
+    {
+        track.sum.fill(0.f);
+        track.sumSq.fill(0.f);
+        for (int age = 0; age < track.count; age++)
+        {
+            const BodyFeatureVector& v = at(track, age);
+            for (int f = 0; f < FEATURE_COUNT; f++)
+            {
+                track.sum[f] += v[f];
+                track.sumSq[f] += v[f] * v[f];
+            }
+        }
+        track.sinceRebuild = 0;
+    }
+
+    const BodyFeatureVector& at(const Track& track, int age) const
+    {
+        // age 0 is the newest frame.
+        return track.ring[(track.head - 1 - age + 2 * window_) % window_];
+    }
+
+    static float ramp(float value, float lo, float hi)
+    {
+        return std::max(0.f, std::min(1.f, (value - lo) / (hi - lo)));
+    }
+
+    void score(Track& track) const
+    {
+        const float n = static_cast<float>(track.count);
+        auto mean = [&](int f) { return track.sum[f] / n; };
+        auto stddev = [&](int f) {
+            const float m = track.sum[f] / n;
+            return std::sqrt(std::max(0.f, track.sumSq[f] / n - m * m));
+        };
+
+        const BodyFeatureVector& now = at(track, 0);
+
+        // Short temporal convolutions over the newest taps.
+        const int taps = std::min(dropTaps_, track.count);
+        const float headDrop = at(track, taps - 1)[FEATURE_HEAD_HEIGHT] - now[FEATURE_HEAD_HEIGHT];
+        float fallVelocity = 0.f; // 3-tap smoothed downward pelvis speed
+        const int smooth = std::min(3, track.count);
+        for (int k = 0; k < smooth; k++)
+        {
+            fallVelocity -= at(track, k)[FEATURE_PELVIS_VERTICAL_SPEED] / smooth;
+        }
+
+        const float headHeight = now[FEATURE_HEAD_HEIGHT];
+        const float pelvisHeight = now[FEATURE_PELVIS_HEIGHT];
+        const float tilt = now[FEATURE_TRUNK_TILT];
+        const float kneeBend = 3.14159265f - 0.5f * (now[FEATURE_LEFT_KNEE_ANGLE] + now[FEATURE_RIGHT_KNEE_ANGLE]);
+        const float footSpeed = 0.5f * (mean(FEATURE_LEFT_FOOT_SPEED) + mean(FEATURE_RIGHT_FOOT_SPEED));
+        const float travel = mean(FEATURE_PELVIS_SPEED);
+
+        const float upright = 1.f - ramp(tilt, 0.5f, 1.2f);
+        const float low = 1.f - ramp(headHeight, 0.4f, 0.9f);
+
+        ActionProbabilities logits;
+        logits[ACTION_STANDING] = 2.f * upright * ramp(headHeight, 1.1f, 1.4f) * (1.f - ramp(footSpeed, 0.15f, 0.4f));
+        logits[ACTION_WALKING] = 2.f * upright * ramp(footSpeed, 0.15f, 0.5f) + ramp(travel, 0.2f, 0.6f)
+                                 - ramp(stddev(FEATURE_PELVIS_HEIGHT), 0.1f, 0.3f);
+        logits[ACTION_SITTING] = 2.f * upright * ramp(kneeBend, 0.6f, 1.2f) *
+                                 ramp(pelvisHeight, 0.2f, 0.35f) * (1.f - ramp(pelvisHeight, 0.6f, 0.8f));
+        logits[ACTION_LYING] = 2.5f * low * ramp(tilt, 0.9f, 1.3f) * (1.f - ramp(fallVelocity, 0.5f, 1.0f));
+        logits[ACTION_FALLING] = 3.f * ramp(fallVelocity, 0.6f, 1.5f) + 2.f * ramp(headDrop, 0.4f, 0.8f) * low;
+
+        const float peak = *std::max_element(logits.begin(), logits.end());
+        float total = 0.f;
+        for (int c = 0; c < ACTION_COUNT; c++)
+        {
+            track.probabilities[c] = std::exp(2.f * (logits[c] - peak));
+            total += track.probabilities[c];
+        }
+        for (auto& p : track.probabilities) { p /= total; }
+    }
+
+    int window_;
+    int dropTaps_;
+    std::array<Track, ASTRA_MAX_BODIES> tracks_;
+};
+
+#endif /* ACTIONCLASSIFIER_HPP */
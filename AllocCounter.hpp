@@ -0,0 +1,104 @@
+#ifndef ALLOCCOUNTER_HPP
+#define ALLOCCOUNTER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counting, for keeping the per-frame path allocation
+// free.
+//
+// Building with -DDOG_ALLOC_COUNT replaces the global operator new and
+// delete with versions that count every allocation, process-wide and per
+// thread; without it the counts stay 0. The replacement is defined right
+// here, so in a program of several translation units only one of them may
+// see DOG_ALLOC_COUNT. Counting is a relaxed atomic add and a thread-local
+// increment, cheap enough to leave on in debug builds.
+
+namespace alloc_count {
+
+inline std::atomic<uint64_t>& total()
+{
+    static std::atomic<uint64_t> count{ 0 };
+    return count;
+}
+
+inline uint64_t& this_thread()
+{
+    thread_local uint64_t count = 0;
+    return count;
+}
+
+} // namespace alloc_count
+
+inline bool heap_counting_enabled()
+{
+#ifdef DOG_ALLOC_COUNT
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Allocations so far by the whole process and by the calling thread.
+inline uint64_t heap_allocations() { return alloc_count::total().load(std::memory_order_relaxed); }
+inline uint64_t thread_heap_allocations() { return alloc_count::this_thread(); }
+
+// Allocations made by the calling thread while the scope is alive.
+class AllocationScope
+{
+public:
+    AllocationScope()
+        : begin_(thread_heap_allocations())
+    { }
+
+    uint64_t count() const { return thread_heap_allocations() - begin_; }
+
+private:
+    uint64_t begin_;
+};
+
+#ifdef DOG_ALLOC_COUNT
+
+void* operator new(std::size_t bytes)
+{
+    alloc_count::total().fetch_add(1, std::memory_order_relaxed);
+    alloc_count::this_thread()++;
+    if (void* p = std::malloc(bytes != 0 ? bytes : 1)) { return p; }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t bytes)
+{
+    return operator new(bytes);
+}
+
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept
+{
+    alloc_count::total().fetch_add(1, std::memory_order_relaxed);
+    alloc_count::this_thread()++;
+    return std::malloc(bytes != 0 ? bytes : 1);
+}
+
+void* operator new[](std::size_t bytes, const std::nothrow_t& tag) noexcept
+{
+    return operator new(bytes, tag);
+}
+
+// GCC 11+ sees free() inlined into delete and, not knowing our new is
+// malloc, reports every delete as mismatched.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
+
+#endif /* ALLOCCOUNTER_HPP */
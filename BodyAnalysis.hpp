@@ -0,0 +1,221 @@
+#ifndef BODYANALYSIS_HPP
+#define BODYANALYSIS_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include "ActionClassifier.hpp"
+#include "BodyFeatures.hpp"
+#include "FloorFrame.hpp"
+#include "FrameArena.hpp"
+#include "FrameClock.hpp"
+#include "StGcn.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// What the dog needs to know about each body in a frame. Shared by the
+// on-board pipeline and the offload server so both decide the same way.
+struct BodyAnalysis
+{
+    astra_body_id_t id{ 0 };
+    ActionProbabilities probabilities{};
+    int action{ ACTION_STANDING };
+    bool accident{ false };
+    float distance{ 0.f }; // m, along the floor from the robot
+    float lateral{ 0.f };  // mm, sideways offset, + to the camera's right
+};
+
+// Who to follow and where they are; PursuitController turns that into
+// a twist.
+struct FollowDecision
+{
+    int target{ -1 };            // index into the analysed bodies, -1 if none
+    astra_body_id_t targetId{ 0 };
+    bool alarm{ false };         // any body in an accident
+    float distance{ 0.f };
+    float lateral{ 0.f };
+    FrameTime sourceTime{ 0 };   // frame clock time the source frame came in
+};
+
+// Tunables of the accident test and of following; the defaults are what
+// the dog shipped with.
+struct AnalysisThresholds
+{
+    float followDistance{ 2.5f };   // m; walk up to the target beyond this
+    float followDeadband{ 50.f };   // mm either side of centre before turning
+    float followLinear{ 1.f };      // m/s, top speed
+    float followAngular{ 0.3f };    // rad/s, top speed
+    float fallHeight{ 400.f };      // mm; centre of mass this close above the feet is a fall
+    float fallProbability{ 0.6f };  // falling plus lying, from the classifiers
+};
+
+// Per-frame body analysis: floor-aligned coordinates, features, the
+// streaming action classifier fused with the ST-GCN model when one is
+// loaded, and the accident test.
+class BodyAnalyzer
+{
+public:
+    bool load_model(const char* path)
+    {
+        return actionModel_.load(path);
+    }
+
+    // Shares a loaded model instead; see stgcn::Runtime::attach().
+    void attach_model(const stgcn::Model& model)
+    {
+        actionModel_.attach(model);
+    }
+
+    // Whether the model may step bodies on extra threads.
+    void set_model_parallel(bool parallel)
+    {
+        actionModel_.set_parallel(parallel);
+    }
+
+    // Skips the learned model, e.g. while a remote host runs it for us.
+    void set_model_enabled(bool enabled)
+    {
+        modelEnabled_ = enabled;
+    }
+
+    void set_thresholds(const AnalysisThresholds& thresholds)
+    {
+        thresholds_ = thresholds;
+    }
+
+    const AnalysisThresholds& thresholds() const { return thresholds_; }
+
+    // Steps the learned model only every `interval` frames; in between,
+    // bodies it has seen reuse its last output.
+    void set_model_interval(int interval)
+    {
+        modelInterval_ = std::max(1, interval);
+    }
+
+    // `arenas` holds this frame's scratch; see FrameArenas.
+    int analyze(FrameTime now, const astra_body_t* const* bodies, int count,
+                const astra_plane_t& floorPlane, bool floorDetected, FrameArenas& arenas)
+    {
+        TRACE_ZONE("BodyAnalyzer::analyze");
+        count_ = std::min(count, static_cast<int>(ASTRA_MAX_BODIES));
+
+        // Posture math runs in the floor-aligned frame so camera pitch
+        // doesn't leak into heights and distances.
+        floorFrame_.update(floorPlane, floorDetected, now, bodies, count_);
+        floorFrame_.transform(bodies, count_, canonicalBodies_.data());
+
+        featureExtractor_.set_floor(FloorFrame::canonical_floor(), true);
+        featureExtractor_.expire(now);
+        actionClassifier_.begin_frame();
+        for (int i = 0; i < count_; i++)
+        {
+            canonicalPtrs_[i] = &canonicalBodies_[i];
+            features_[i] = featureExtractor_.extract(canonicalBodies_[i], now);
+            results_[i].id = bodies[i]->id;
+            results_[i].probabilities = actionClassifier_.update(bodies[i]->id, features_[i]);
+        }
+
+        if (modelEnabled_)
+        {
+            if (modelFrame_++ % modelInterval_ == 0)
+            {
+                actionModel_.step(canonicalPtrs_.data(), count_, actionSlots_.data(), arenas);
+            }
+            else
+            {
+                for (int i = 0; i < count_; i++) { actionSlots_[i] = actionModel_.find_slot(bodies[i]->id); }
+            }
+            if (actionModel_.is_loaded() && actionModel_.class_count() == ACTION_COUNT)
+            {
+                for (int i = 0; i < count_; i++)
+                {
+                    if (actionSlots_[i] < 0) { continue; }
+                    const auto& learned = actionModel_.probabilities(actionSlots_[i]);
+                    for (int c = 0; c < ACTION_COUNT; c++)
+                    {
+                        results_[i].probabilities[c] = 0.5f * (results_[i].probabilities[c] + learned[c]);
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < count_; i++)
+        {
+            analyze_body(canonicalBodies_[i], results_[i]);
+        }
+        return count_;
+    }
+
+    // The nearest body is the one to follow.
+    FollowDecision decide() const
+    {
+        FollowDecision decision;
+        for (int i = 0; i < count_; i++)
+        {
+            const BodyAnalysis& body = results_[i];
+            decision.alarm = decision.alarm || body.accident;
+            if (decision.target < 0 || body.distance < decision.distance)
+            {
+                decision.target = i;
+                decision.targetId = body.id;
+                decision.distance = body.distance;
+                decision.lateral = body.lateral;
+            }
+        }
+        return decision;
+    }
+
+    int count() const { return count_; }
+    const BodyAnalysis& result(int i) const { return results_[i]; }
+    const BodyFeatureVector& features(int i) const { return features_[i]; }
+    const astra_body_t& canonical_body(int i) const { return canonicalBodies_[i]; }
+
+private:
+    void analyze_body(const astra_body_t& canonical, BodyAnalysis& result) const
+    {
+        const ActionProbabilities& p = result.probabilities;
+        result.action = static_cast<int>(std::max_element(p.begin(), p.end()) - p.begin());
+
+        // Lowest tracked foot; the fallback tracker may only find one. Lying
+        // flat puts the feet level with the centre of mass, so a foot at or
+        // above it still counts.
+        bool footFound = false;
+        float footY = 0.f;
+        for (int foot : { ASTRA_JOINT_LEFT_FOOT, ASTRA_JOINT_RIGHT_FOOT })
+        {
+            if (canonical.joints[foot].status != ASTRA_JOINT_STATUS_NOT_TRACKED)
+            {
+                const float y = canonical.joints[foot].worldPosition.y;
+                footY = footFound ? std::min(footY, y) : y;
+                footFound = true;
+            }
+        }
+        result.accident = (footFound && canonical.centerOfMass.y - footY < thresholds_.fallHeight) ||
+                          p[ACTION_FALLING] + p[ACTION_LYING] > thresholds_.fallProbability;
+
+        const astra_vector3f_t& baseSpine = canonical.joints[ASTRA_JOINT_BASE_SPINE].worldPosition;
+        result.distance = std::sqrt(baseSpine.x * baseSpine.x + baseSpine.z * baseSpine.z) / 1000.f;
+        result.lateral = baseSpine.x;
+    }
+
+    int count_{ 0 };
+    AnalysisThresholds thresholds_;
+    bool modelEnabled_{ true };
+    int modelInterval_{ 1 };
+    unsigned modelFrame_{ 0 };
+
+    FloorFrame floorFrame_;
+    std::array<astra_body_t, ASTRA_MAX_BODIES> canonicalBodies_;
+    std::array<const astra_body_t*, ASTRA_MAX_BODIES> canonicalPtrs_;
+
+    BodyFeatureExtractor featureExtractor_;
+    std::array<BodyFeatureVector, ASTRA_MAX_BODIES> features_;
+
+    ActionClassifier actionClassifier_;
+    stgcn::Runtime actionModel_;
+    std::array<int, ASTRA_MAX_BODIES> actionSlots_;
+
+    std::array<BodyAnalysis, ASTRA_MAX_BODIES> results_;
+};
+
+#endif /* BODYANALYSIS_HPP */
@@ -0,0 +1,317 @@
+#ifndef BODYFEATURES_HPP
+#define BODYFEATURES_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include "FrameClock.hpp"
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Layout of the per-body feature vector. Angles are in radians, heights
+// and extents in metres, speeds in metres per second.
+enum BodyFeature
+{
+    FEATURE_LEFT_ELBOW_ANGLE = 0,
+    FEATURE_RIGHT_ELBOW_ANGLE,
+    FEATURE_LEFT_KNEE_ANGLE,
+    FEATURE_RIGHT_KNEE_ANGLE,
+    FEATURE_LEFT_HIP_ANGLE,
+    FEATURE_RIGHT_HIP_ANGLE,
+    FEATURE_TRUNK_TILT,
+
+    FEATURE_HEAD_SPEED,
+    FEATURE_TRUNK_SPEED,
+    FEATURE_PELVIS_SPEED,
+    FEATURE_LEFT_HAND_SPEED,
+    FEATURE_RIGHT_HAND_SPEED,
+    FEATURE_LEFT_FOOT_SPEED,
+    FEATURE_RIGHT_FOOT_SPEED,
+    FEATURE_PELVIS_VERTICAL_SPEED,
+
+    FEATURE_HEAD_HEIGHT,
+    FEATURE_PELVIS_HEIGHT,
+    FEATURE_COM_HEIGHT,
+
+    FEATURE_BBOX_ASPECT,
+    FEATURE_TRACKED_RATIO,
+
+    FEATURE_COUNT
+};
+
+using BodyFeatureVector = std::array<float, FEATURE_COUNT>;
+
+// Joints of one body as a structure of arrays, so per-joint math runs as
+// straight loops over contiguous floats.
+struct JointSoA
+{
+    float x[ASTRA_MAX_JOINTS];
+    float y[ASTRA_MAX_JOINTS];
+    float z[ASTRA_MAX_JOINTS];
+    float tracked[ASTRA_MAX_JOINTS]; // 1.f if tracked (any confidence), else 0.f
+
+    void load(const astra_body_t& body)
+    {
+        for (int i = 0; i < ASTRA_MAX_JOINTS; i++)
+        {
+            const astra_joint_t& joint = body.joints[i];
+            x[i] = joint.worldPosition.x;
+            y[i] = joint.worldPosition.y;
+            z[i] = joint.worldPosition.z;
+            tracked[i] = joint.status != ASTRA_JOINT_STATUS_NOT_TRACKED ? 1.f : 0.f;
+        }
+    }
+};
+
+class BodyFeatureExtractor
+{
+public:
+    // Uses the floor plane for heights and the up direction. Without a floor
+    // the camera's +Y is taken as up and heights are measured from the
+    // lowest tracked foot.
+    void set_floor(const astra_plane_t& plane, bool detected)
+    {
+        const float len = std::sqrt(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+        floorValid_ = detected && len > 1e-6f;
+        if (floorValid_)
+        {
+            upX_ = plane.a / len;
+            upY_ = plane.b / len;
+            upZ_ = plane.c / len;
+            upD_ = plane.d / len;
+        }
+        else
+        {
+            upX_ = 0.f;
+            upY_ = 1.f;
+            upZ_ = 0.f;
+            upD_ = 0.f;
+        }
+    }
+
+    const BodyFeatureVector& extract(const astra_body_t& body, FrameTime timestamp)
+    {
+        History& history = history_for(body.id, timestamp);
+        JointSoA& cur = current_;
+        cur.load(body);
+
+        BodyFeatureVector& out = history.features;
+        out.fill(0.f);
+
+        compute_angles(cur, out);
+        compute_heights(cur, body.centerOfMass, out);
+
+        if (history.timestamp != 0 && timestamp > history.timestamp)
+        {
+            const float dt = static_cast<float>(frame_time_seconds(timestamp - history.timestamp));
+            compute_velocities(cur, history.joints, dt, out);
+        }
+
+        history.joints = cur;
+        history.timestamp = timestamp;
+        return out;
+    }
+
+    // Drops state for bodies that have not been seen for a while.
+    void expire(FrameTime now, FrameTime maxAge = 2000000000LL)
+    {
+        for (auto& h : histories_)
+        {
+            if (h.id != ASTRA_INVALID_BODY_ID && now - h.lastSeen > maxAge)
+            {
+                h.id = ASTRA_INVALID_BODY_ID;
+            }
+        }
+    }
+
+private:
+    struct History
+    {
+        astra_body_id_t id{ ASTRA_INVALID_BODY_ID };
+        FrameTime timestamp{ 0 };
+        FrameTime lastSeen{ 0 };
+        JointSoA joints;
+        BodyFeatureVector features;
+    };
+
+    static const int kAngleCount = 6;
+    static const int kSpeedCount = 7;
+
+    History& history_for(astra_body_id_t id, FrameTime now)
+    {
+        History* freeSlot = nullptr;
+        History* oldest = &histories_[0];
+        for (auto& h : histories_)
+        {
+            if (h.id == id)
+            {
+                h.lastSeen = now;
+                return h;
+            }
+            if (h.id == ASTRA_INVALID_BODY_ID && freeSlot == nullptr)
+            {
+                freeSlot = &h;
+            }
+            if (h.lastSeen < oldest->lastSeen)
+            {
+                oldest = &h;
+            }
+        }
+
+        History& slot = freeSlot != nullptr ? *freeSlot : *oldest;
+        slot.id = id;
+        slot.timestamp = 0;
+        slot.lastSeen = now;
+        return slot;
+    }
+
+    void compute_angles(const JointSoA& j, BodyFeatureVector& out) const
+    {
+        // Angle at joint b between segments b->a and b->c.
+        static const int a[kAngleCount] = {
+            ASTRA_JOINT_LEFT_SHOULDER, ASTRA_JOINT_RIGHT_SHOULDER,
+            ASTRA_JOINT_LEFT_HIP, ASTRA_JOINT_RIGHT_HIP,
+            ASTRA_JOINT_MID_SPINE, ASTRA_JOINT_MID_SPINE };
+        static const int b[kAngleCount] = {
+            ASTRA_JOINT_LEFT_ELBOW, ASTRA_JOINT_RIGHT_ELBOW,
+            ASTRA_JOINT_LEFT_KNEE, ASTRA_JOINT_RIGHT_KNEE,
+            ASTRA_JOINT_LEFT_HIP, ASTRA_JOINT_RIGHT_HIP };
+        static const int c[kAngleCount] = {
+            ASTRA_JOINT_LEFT_WRIST, ASTRA_JOINT_RIGHT_WRIST,
+            ASTRA_JOINT_LEFT_FOOT, ASTRA_JOINT_RIGHT_FOOT,
+            ASTRA_JOINT_LEFT_KNEE, ASTRA_JOINT_RIGHT_KNEE };
+
+        float ux[kAngleCount], uy[kAngleCount], uz[kAngleCount];
+        float vx[kAngleCount], vy[kAngleCount], vz[kAngleCount];
+        float valid[kAngleCount];
+        for (int i = 0; i < kAngleCount; i++)
+        {
+            ux[i] = j.x[a[i]] - j.x[b[i]];
+            uy[i] = j.y[a[i]] - j.y[b[i]];
+            uz[i] = j.z[a[i]] - j.z[b[i]];
+            vx[i] = j.x[c[i]] - j.x[b[i]];
+            vy[i] = j.y[c[i]] - j.y[b[i]];
+            vz[i] = j.z[c[i]] - j.z[b[i]];
+            valid[i] = j.tracked[a[i]] * j.tracked[b[i]] * j.tracked[c[i]];
+        }
+
+        float cosine[kAngleCount];
+        for (int i = 0; i < kAngleCount; i++)
+        {
+            const float dot = ux[i] * vx[i] + uy[i] * vy[i] + uz[i] * vz[i];
+            const float norm2 = (ux[i] * ux[i] + uy[i] * uy[i] + uz[i] * uz[i]) *
+                                (vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+            cosine[i] = norm2 > 1e-6f ? dot / std::sqrt(norm2) : 1.f;
+        }
+
+        for (int i = 0; i < kAngleCount; i++)
+        {
+            const float clamped = std::max(-1.f, std::min(1.f, cosine[i]));
+            out[FEATURE_LEFT_ELBOW_ANGLE + i] = valid[i] * std::acos(clamped);
+        }
+
+        // Trunk tilt: angle between pelvis->shoulders and the up direction.
+        const int lo = ASTRA_JOINT_BASE_SPINE;
+        const int hi = ASTRA_JOINT_SHOULDER_SPINE;
+        const float tx = j.x[hi] - j.x[lo];
+        const float ty = j.y[hi] - j.y[lo];
+        const float tz = j.z[hi] - j.z[lo];
+        const float len = std::sqrt(tx * tx + ty * ty + tz * tz);
+        if (len > 1e-3f && j.tracked[lo] * j.tracked[hi] > 0.f)
+        {
+            const float cosTilt = (tx * upX_ + ty * upY_ + tz * upZ_) / len;
+            out[FEATURE_TRUNK_TILT] = std::acos(std::max(-1.f, std::min(1.f, cosTilt)));
+        }
+    }
+
+    void compute_heights(const JointSoA& j, const astra_vector3f_t& com, BodyFeatureVector& out) const
+    {
+        // Signed height of every joint along the up direction, in mm.
+        float h[ASTRA_MAX_JOINTS];
+        for (int i = 0; i < ASTRA_MAX_JOINTS; i++)
+        {
+            h[i] = j.x[i] * upX_ + j.y[i] * upY_ + j.z[i] * upZ_ + upD_;
+        }
+
+        float hMin = 1e9f, hMax = -1e9f;
+        float xMin = 1e9f, xMax = -1e9f;
+        float zMin = 1e9f, zMax = -1e9f;
+        float trackedCount = 0.f;
+        for (int i = 0; i < ASTRA_MAX_JOINTS; i++)
+        {
+            if (j.tracked[i] == 0.f) { continue; }
+            hMin = std::min(hMin, h[i]);
+            hMax = std::max(hMax, h[i]);
+            xMin = std::min(xMin, j.x[i]);
+            xMax = std::max(xMax, j.x[i]);
+            zMin = std::min(zMin, j.z[i]);
+            zMax = std::max(zMax, j.z[i]);
+            trackedCount += 1.f;
+        }
+
+        out[FEATURE_TRACKED_RATIO] = trackedCount / ASTRA_MAX_JOINTS;
+        if (trackedCount == 0.f)
+        {
+            return;
+        }
+
+        float ground = 0.f;
+        if (!floorValid_)
+        {
+            ground = hMin;
+            const int lf = ASTRA_JOINT_LEFT_FOOT;
+            const int rf = ASTRA_JOINT_RIGHT_FOOT;
+            if (j.tracked[lf] > 0.f && j.tracked[rf] > 0.f) { ground = std::min(h[lf], h[rf]); }
+            else if (j.tracked[lf] > 0.f) { ground = h[lf]; }
+            else if (j.tracked[rf] > 0.f) { ground = h[rf]; }
+        }
+
+        const float comHeight = com.x * upX_ + com.y * upY_ + com.z * upZ_ + upD_;
+        out[FEATURE_HEAD_HEIGHT] = (h[ASTRA_JOINT_HEAD] - ground) * 0.001f * j.tracked[ASTRA_JOINT_HEAD];
+        out[FEATURE_PELVIS_HEIGHT] = (h[ASTRA_JOINT_BASE_SPINE] - ground) * 0.001f * j.tracked[ASTRA_JOINT_BASE_SPINE];
+        out[FEATURE_COM_HEIGHT] = (comHeight - ground) * 0.001f;
+
+        const float vertical = hMax - hMin;
+        const float horizontal = std::max(xMax - xMin, zMax - zMin);
+        out[FEATURE_BBOX_ASPECT] = vertical / std::max(horizontal, 1.f);
+    }
+
+    void compute_velocities(const JointSoA& cur, const JointSoA& prev, float dt, BodyFeatureVector& out) const
+    {
+        const float invDt = 0.001f / dt; // mm per frame -> m/s
+
+        float speed[ASTRA_MAX_JOINTS];
+        float vertical[ASTRA_MAX_JOINTS];
+        for (int i = 0; i < ASTRA_MAX_JOINTS; i++)
+        {
+            const float dx = (cur.x[i] - prev.x[i]) * invDt;
+            const float dy = (cur.y[i] - prev.y[i]) * invDt;
+            const float dz = (cur.z[i] - prev.z[i]) * invDt;
+            const float both = cur.tracked[i] * prev.tracked[i];
+            speed[i] = both * std::sqrt(dx * dx + dy * dy + dz * dz);
+            vertical[i] = both * (dx * upX_ + dy * upY_ + dz * upZ_);
+        }
+
+        static const int segment[kSpeedCount] = {
+            ASTRA_JOINT_HEAD, ASTRA_JOINT_MID_SPINE, ASTRA_JOINT_BASE_SPINE,
+            ASTRA_JOINT_LEFT_HAND, ASTRA_JOINT_RIGHT_HAND,
+            ASTRA_JOINT_LEFT_FOOT, ASTRA_JOINT_RIGHT_FOOT };
+        for (int i = 0; i < kSpeedCount; i++)
+        {
+            out[FEATURE_HEAD_SPEED + i] = speed[segment[i]];
+        }
+        out[FEATURE_PELVIS_VERTICAL_SPEED] = vertical[ASTRA_JOINT_BASE_SPINE];
+    }
+
+    std::array<History, ASTRA_MAX_BODIES> histories_;
+    JointSoA current_;
+
+    bool floorValid_{ false };
+    float upX_{ 0.f };
+    float upY_{ 1.f };
+    float upZ_{ 0.f };
+    float upD_{ 0.f };
+};
+
+#endif /* BODYFEATURES_HPP */
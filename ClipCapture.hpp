@@ -0,0 +1,283 @@
+#ifndef CLIPCAPTURE_HPP
+#define CLIPCAPTURE_HPP
+
+#include "DepthCodec.hpp"
+#include "FrameClock.hpp"
+#include "FrameViews.hpp"
+#include "Recording.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps the last few seconds of depth + skeleton frames in memory and
+// writes them out, together with the seconds that follow, when an alarm
+// is raised.
+//
+// Everything is allocated up front: three staging frames, a ring of frame
+// slots and a byte ring for RVL-compressed depth. The processing thread
+// copies the frame into its staging buffer and swaps it with the mailbox;
+// a background thread takes it from there, compresses it into the rings
+// and, once the post-event time has passed, writes the clip. If the
+// background thread falls behind, the frame in the mailbox is replaced
+// and counted as dropped.
+//
+// While a clip is being collected its pre-event frames are never evicted;
+// if the rings fill up, later frames are dropped instead. Alarms raised
+// while a clip is being collected are folded into it; one raised after
+// its post-event time starts the next clip.
+class ClipCapture
+{
+public:
+    ClipCapture(const std::string& directory,
+                FrameTime preEvent = 10000000000LL,
+                FrameTime postEvent = 5000000000LL,
+                size_t ringBytes = 96u << 20,
+                int maxFps = 30)
+        : directory_(directory),
+          preEvent_(preEvent),
+          postEvent_(postEvent),
+          slots_(static_cast<size_t>(frame_time_seconds(preEvent + postEvent) * maxFps * 5 / 4) + 1),
+          bytes_(ringBytes),
+          scratch_(depth_max_encoded_size(ASTRA_TEMP_IMAGE_LENGTH))
+    {
+        for (Staging& staging : staging_)
+        {
+            staging.depth.resize(ASTRA_TEMP_IMAGE_LENGTH);
+        }
+        hot_ = &staging_[0];
+        mailbox_.store(&staging_[1]);
+        cold_ = &staging_[2];
+        worker_ = std::thread([this] { worker_loop(); });
+    }
+
+    ~ClipCapture()
+    {
+        stopping_ = true;
+        worker_.join();
+    }
+
+    ClipCapture(const ClipCapture&) = delete;
+    ClipCapture& operator=(const ClipCapture&) = delete;
+
+    // Called once per processed frame.
+    void push(FrameTime timestamp, const DepthView& depth, const BodyFrameView& body)
+    {
+        Staging& s = *hot_;
+        s.timestamp = timestamp;
+        s.hasDepth = depth.is_valid() && static_cast<size_t>(depth.width) * depth.height <= s.depth.size();
+        if (s.hasDepth)
+        {
+            s.width = depth.width;
+            s.height = depth.height;
+            s.frameIndex = depth.frameIndex;
+            std::memcpy(s.depth.data(), depth.data, static_cast<size_t>(depth.width) * depth.height * sizeof(int16_t));
+        }
+        s.body = body;
+        s.body.count = body.valid ? std::min(body.count, static_cast<int>(ASTRA_MAX_BODIES)) : 0;
+        std::memcpy(s.bodies, body.bodies, s.body.count * sizeof(astra_body_t));
+        s.body.bodies = s.bodies;
+        s.body.bodyMask = nullptr;
+        s.body.floorMask = nullptr;
+        s.fresh = true;
+
+        hot_ = mailbox_.exchange(hot_, std::memory_order_acq_rel);
+        if (hot_->fresh)
+        {
+            dropped_++;
+        }
+    }
+
+    // Raises an alarm at frame time `at`; the clip covers
+    // [at - preEvent, at + postEvent].
+    void trigger(FrameTime at)
+    {
+        FrameTime none = 0;
+        alarm_.compare_exchange_strong(none, at);
+    }
+
+    size_t dropped_frames() const { return dropped_.load(); }
+    size_t clips_written() const { return clipsWritten_.load(); }
+
+private:
+    struct Staging
+    {
+        bool fresh{ false };
+        FrameTime timestamp{ 0 };
+        bool hasDepth{ false };
+        int width{ 0 };
+        int height{ 0 };
+        astra_frame_index_t frameIndex{ 0 };
+        std::vector<int16_t> depth;
+        BodyFrameView body;
+        astra_body_t bodies[ASTRA_MAX_BODIES];
+    };
+
+    struct Slot
+    {
+        FrameTime timestamp{ 0 };
+        EncodedDepth depth;      // data is an offset into bytes_ until written
+        size_t offset{ 0 };
+        BodyFrameView body;
+        astra_body_t bodies[ASTRA_MAX_BODIES];
+    };
+
+    void worker_loop()
+    {
+        TRACE_THREAD("clip capture");
+        while (!stopping_)
+        {
+            cold_ = mailbox_.exchange(cold_, std::memory_order_acq_rel);
+            if (!cold_->fresh)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                continue;
+            }
+            store(*cold_);
+            cold_->fresh = false;
+
+            FrameTime alarm = alarm_.load();
+            if (alarm != 0 && cold_->timestamp >= alarm + postEvent_)
+            {
+                // Cleared before writing, so an alarm raised while the clip
+                // is written starts the next one instead of being lost.
+                const FrameTime done = alarm;
+                alarm_.compare_exchange_strong(alarm, 0);
+                write_clip(done);
+            }
+        }
+
+        const FrameTime alarm = alarm_.load();
+        if (alarm != 0)
+        {
+            write_clip(alarm);
+        }
+    }
+
+    void store(const Staging& frame)
+    {
+        TRACE_ZONE("ClipCapture::store");
+        uint32_t bytes = 0;
+        if (frame.hasDepth)
+        {
+            bytes = static_cast<uint32_t>(depth_encode(frame.depth.data(),
+                static_cast<size_t>(frame.width) * frame.height, scratch_.data()));
+        }
+
+        size_t offset = 0;
+        if (!reserve(bytes, offset))
+        {
+            dropped_++;
+            return;
+        }
+
+        Slot& slot = slots_[(head_ + count_) % slots_.size()];
+        count_++;
+        slot.timestamp = frame.timestamp;
+        slot.offset = offset;
+        slot.depth = EncodedDepth();
+        if (frame.hasDepth)
+        {
+            std::memcpy(bytes_.data() + offset, scratch_.data(), bytes);
+            slot.depth.bytes = bytes;
+            slot.depth.encoding = DEPTH_ENCODING_RVL;
+            slot.depth.width = frame.width;
+            slot.depth.height = frame.height;
+            slot.depth.frameIndex = frame.frameIndex;
+        }
+        slot.body = frame.body;
+        std::memcpy(slot.bodies, frame.bodies, frame.body.count * sizeof(astra_body_t));
+        slot.body.bodies = slot.bodies;
+        writePos_ = offset + bytes;
+    }
+
+    // Finds room for `bytes` of depth and a slot, evicting the oldest frames
+    // unless they belong to the clip being collected.
+    bool reserve(size_t bytes, size_t& offset)
+    {
+        if (bytes > bytes_.size()) { return false; }
+        if (count_ == 0) { writePos_ = 0; }
+
+        const bool wrap = writePos_ + bytes > bytes_.size();
+        const size_t pos = wrap ? 0 : writePos_;
+        const size_t oldWritePos = writePos_;
+        while (count_ > 0)
+        {
+            const Slot& oldest = slots_[head_];
+            // A slot without depth still marks where the next slot's data
+            // starts, so one sitting in the range counts as overlapping.
+            const bool overlaps = (oldest.offset < pos + bytes && pos < oldest.offset + oldest.depth.bytes) ||
+                                  (oldest.offset >= pos && oldest.offset <= pos + bytes);
+            const bool beyondWrap = wrap && oldest.offset >= oldWritePos;
+            if (!overlaps && !beyondWrap && count_ < slots_.size()) { break; }
+
+            const FrameTime alarm = alarm_.load();
+            if (alarm != 0 && oldest.timestamp >= alarm - preEvent_)
+            {
+                return false;
+            }
+            head_ = (head_ + 1) % slots_.size();
+            count_--;
+        }
+        offset = pos;
+        return true;
+    }
+
+    void write_clip(FrameTime alarm)
+    {
+        char stamp[32];
+        const std::time_t now = std::time(nullptr);
+        std::tm local;
+        localtime_r(&now, &local);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+        // Numbered too: back-to-back clips can share a second.
+        const std::string path = directory_ + "/fall-" + stamp + "-" + std::to_string(clipsWritten_.load() + 1) + ".rec";
+
+        FrameRecorder recorder;
+        if (!recorder.open(path.c_str(), false)) { return; }
+
+        size_t frames = 0;
+        for (size_t i = 0; i < count_; i++)
+        {
+            Slot& slot = slots_[(head_ + i) % slots_.size()];
+            if (slot.timestamp < alarm - preEvent_ || slot.timestamp > alarm + postEvent_) { continue; }
+            EncodedDepth depth = slot.depth;
+            depth.data = depth.bytes > 0 ? bytes_.data() + slot.offset : nullptr;
+            if (!recorder.write_frame(slot.timestamp, depth, slot.body)) { return; }
+            frames++;
+        }
+        recorder.close();
+        clipsWritten_++;
+        printf("Clip: wrote %zu frames to %s\n", frames, path.c_str());
+    }
+
+    std::string directory_;
+    FrameTime preEvent_;
+    FrameTime postEvent_;
+
+    Staging staging_[3];
+    Staging* hot_;
+    std::atomic<Staging*> mailbox_{ nullptr };
+    Staging* cold_;
+
+    std::vector<Slot> slots_;
+    size_t head_{ 0 };
+    size_t count_{ 0 };
+    std::vector<uint8_t> bytes_;
+    size_t writePos_{ 0 };
+    std::vector<uint8_t> scratch_;
+
+    std::atomic<FrameTime> alarm_{ 0 };
+    std::atomic<size_t> dropped_{ 0 };
+    std::atomic<size_t> clipsWritten_{ 0 };
+    std::atomic<bool> stopping_{ false };
+    std::thread worker_;
+};
+
+#endif /* CLIPCAPTURE_HPP */
@@ -0,0 +1,191 @@
+#ifndef CMDVELWATCHDOG_HPP
+#define CMDVELWATCHDOG_HPP
+
+#include "BodyAnalysis.hpp"
+#include "FrameClock.hpp"
+#include "Metrics.hpp"
+#include "PursuitController.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Publishes the follow twist from a thread of its own, so a stalled
+// camera or an astra_update() that never returns can't leave the dog
+// driving on its last command.
+//
+// The main loop hands over every decision with submit(); each carries the
+// time its source frame came in (FollowDecision::sourceTime). Once per
+// period the watchdog steps the PursuitController with the latest decision
+// and publishes its twist. Once that decision is older than `maxAge`, the
+// speed cap ramps linearly down to zero over `ramp` and stays there until
+// fresh frames come back. Each time the data goes stale counts as one
+// stall.
+//
+// The thread asks for SCHED_FIFO so it keeps its period on a busy host;
+// without the privilege it stays on the normal scheduler and says so.
+class CmdVelWatchdog
+{
+public:
+    using Publish = std::function<void(float linear, float angular)>;
+
+    explicit CmdVelWatchdog(Publish publish,
+                            FrameTime maxAge = 300000000LL,
+                            FrameTime ramp = 500000000LL)
+        : publish_(std::move(publish)),
+          maxAge_(maxAge),
+          ramp_(ramp)
+    {}
+
+    ~CmdVelWatchdog()
+    {
+        stop();
+    }
+
+    CmdVelWatchdog(const CmdVelWatchdog&) = delete;
+    CmdVelWatchdog& operator=(const CmdVelWatchdog&) = delete;
+
+    void start(double rateHz)
+    {
+        if (thread_.joinable()) { return; }
+        set_rate(rateHz);
+        stopping_ = false;
+        thread_ = std::thread([this] { run(); });
+        raise_priority();
+    }
+
+    void stop()
+    {
+        if (!thread_.joinable()) { return; }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+    bool is_running() const { return thread_.joinable(); }
+
+    void set_rate(double rateHz)
+    {
+        period_.store(static_cast<FrameTime>(1e9 / std::max(rateHz, 0.1)), std::memory_order_relaxed);
+    }
+
+    void set_limits(FrameTime maxAge, FrameTime ramp)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxAge_ = maxAge;
+        ramp_ = ramp;
+    }
+
+    void configure_follow(const AnalysisThresholds& thresholds, const PursuitSettings& settings)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        controller_.configure(thresholds, settings);
+    }
+
+    // Never allocates; cheap enough for every main loop iteration.
+    void submit(const FollowDecision& decision)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (decision.sourceTime >= latest_.sourceTime) { latest_ = decision; }
+    }
+
+    // What to publish at `now`, and the age of the data behind it. Call
+    // once per period; the controller's slew limits count on it.
+    void command(FrameTime now, float& linear, float& angular, FrameTime& age)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        age = latest_.sourceTime > 0 ? now - latest_.sourceTime : -1;
+        const bool stale = age < 0 || age > maxAge_;
+        float scale = 1.f;
+        if (stale)
+        {
+            scale = age < 0 || ramp_ <= 0 ? 0.f : std::max(0.f, 1.f - static_cast<float>(age - maxAge_) / ramp_);
+        }
+        controller_.step(now, latest_, scale, linear, angular);
+
+        // Before the first frame nothing has moved yet; not a stall.
+        if (age < 0) { return; }
+        if (stale && !stale_)
+        {
+            stalls_.add();
+            printf("Watchdog: no fresh frame for %.0f ms, stopping over %.0f ms\n", age / 1e6, ramp_ / 1e6);
+        }
+        else if (!stale && stale_)
+        {
+            printf("Watchdog: fresh frames again\n");
+        }
+        stale_ = stale;
+    }
+
+    uint64_t stalls() const { return stalls_.value(); }
+
+    void register_with(MetricsRegistry& registry) const
+    {
+        registry.add("dog_cmd_vel_stalls_total", "Times the follow data went stale and the dog was stopped.", stalls_);
+        registry.add("dog_cmd_vel_data_age_seconds", "Age of the frame behind the last /cmd_vel publish.", dataAge_);
+        controller_.register_with(registry);
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto next = std::chrono::steady_clock::now();
+        while (!stopping_)
+        {
+            lock.unlock();
+            float linear = 0.f;
+            float angular = 0.f;
+            FrameTime age = 0;
+            command(frame_clock_now(), linear, angular, age);
+            dataAge_.set(age < 0 ? -1.0 : frame_time_seconds(age));
+            publish_(linear, angular);
+            lock.lock();
+
+            next += std::chrono::nanoseconds(period_.load(std::memory_order_relaxed));
+            const auto now = std::chrono::steady_clock::now();
+            if (next < now) { next = now; }  // don't burst after a slow publish
+            wake_.wait_until(lock, next, [this] { return stopping_; });
+        }
+    }
+
+    void raise_priority()
+    {
+        sched_param param;
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+        const int error = pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param);
+        if (error != 0)
+        {
+            printf("Watchdog: no real-time priority (%s), running at normal priority\n", strerror(error));
+        }
+    }
+
+    Publish publish_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_{ false };
+    std::atomic<FrameTime> period_{ 33333333LL };
+
+    // Guarded by mutex_.
+    FollowDecision latest_;
+    PursuitController controller_;
+    FrameTime maxAge_;
+    FrameTime ramp_;
+    bool stale_{ false };
+
+    MetricCounter stalls_;
+    MetricGauge dataAge_;
+};
+
+#endif /* CMDVELWATCHDOG_HPP */
@@ -0,0 +1,329 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include "BodyAnalysis.hpp"
+#include "PursuitController.hpp"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The dog's tunables, read from a TOML file in the style of the SDK's
+// astra.toml (dog.toml next to the binary by default) and re-read
+// whenever the file is saved.
+//
+// Only the TOML the file needs is understood: [section] headers and
+// `key = value` lines with strings, booleans, integers and floats, plus
+// # comments. Every key is optional; a missing file gives the defaults.
+// A file that fails to parse or holds an out-of-range value is rejected as
+// a whole, with the line, and the previous settings stay in force.
+
+struct DogConfig
+{
+    // [depth] stream mode; the pipeline works in mm throughout, so the
+    // pixel format is always ASTRA_PIXEL_FORMAT_DEPTH_MM. Only the
+    // sensor's modes up to 640x480 are accepted: clip capture and offload
+    // size their buffers for ASTRA_TEMP_IMAGE_LENGTH.
+    int depthWidth{ 640 };
+    int depthHeight{ 480 };
+    int depthFps{ 30 };
+
+    // [follow] and [accident]
+    AnalysisThresholds thresholds;
+    PursuitSettings pursuit;
+
+    // [robot]
+    double cmdVelRate{ 30.0 };       // Hz, also the follow controller's rate
+    double maxDataAge{ 300.0 };      // ms before the watchdog stops the dog
+    double stopRamp{ 500.0 };        // ms from the last command down to zero
+
+    // [pipeline]
+    int fallbackDelay{ 30 };         // empty SDK frames before the depth-only tracker
+    bool model{ false };             // ST-GCN on board; see dog.toml
+    double latencyBudget{ 50.0 };    // ms, for the quality governor; 0 turns it off
+};
+
+namespace config_detail {
+
+struct Value
+{
+    std::string section;
+    std::string key;
+    std::string text;
+    bool quoted;
+    int line;
+    bool used;
+};
+
+inline std::string trim(const std::string& s)
+{
+    const size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) { return std::string(); }
+    return s.substr(begin, s.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+class Parser
+{
+public:
+    explicit Parser(const char* path)
+        : path_(path)
+    {}
+
+    bool parse(FILE* fp)
+    {
+        std::string section;
+        char buffer[512];
+        int line = 0;
+        while (fgets(buffer, sizeof(buffer), fp) != nullptr)
+        {
+            line++;
+            std::string text = buffer;
+            bool inString = false;
+            for (size_t i = 0; i < text.size(); i++)
+            {
+                if (text[i] == '"') { inString = !inString; }
+                if (text[i] == '#' && !inString)
+                {
+                    text.resize(i);
+                    break;
+                }
+            }
+            text = trim(text);
+            if (text.empty()) { continue; }
+
+            if (text[0] == '[')
+            {
+                if (text.back() != ']') { return fail(line, "expected ]"); }
+                section = trim(text.substr(1, text.size() - 2));
+                continue;
+            }
+
+            const size_t equals = text.find('=');
+            if (equals == std::string::npos) { return fail(line, "expected key = value"); }
+            Value value{ section, trim(text.substr(0, equals)), trim(text.substr(equals + 1)), false, line, false };
+            if (value.key.empty() || value.text.empty()) { return fail(line, "expected key = value"); }
+            if (value.text[0] == '"')
+            {
+                if (value.text.size() < 2 || value.text.back() != '"') { return fail(line, "unterminated string"); }
+                value.text = value.text.substr(1, value.text.size() - 2);
+                value.quoted = true;
+            }
+            values_.push_back(value);
+        }
+        return true;
+    }
+
+    // Each leaves `out` alone when the key is absent and fails when it is
+    // present but not a number in [min, max] (or not a boolean).
+    bool read(const char* section, const char* key, double& out, double min, double max)
+    {
+        Value* value = find(section, key);
+        if (value == nullptr) { return true; }
+        char* end = nullptr;
+        const double number = value->quoted ? 0.0 : strtod(value->text.c_str(), &end);
+        if (value->quoted || end == value->text.c_str() || *end != '\0' || number < min || number > max)
+        {
+            char message[128];
+            snprintf(message, sizeof(message), "%s.%s must be a number from %g to %g", section, key, min, max);
+            return fail(value->line, message);
+        }
+        out = number;
+        return true;
+    }
+
+    bool read(const char* section, const char* key, float& out, double min, double max)
+    {
+        double number = out;
+        if (!read(section, key, number, min, max)) { return false; }
+        out = static_cast<float>(number);
+        return true;
+    }
+
+    bool read(const char* section, const char* key, int& out, int min, int max)
+    {
+        double number = out;
+        if (!read(section, key, number, min, max)) { return false; }
+        if (number != static_cast<int>(number))
+        {
+            return fail(find(section, key)->line, "expected a whole number");
+        }
+        out = static_cast<int>(number);
+        return true;
+    }
+
+    bool read(const char* section, const char* key, bool& out)
+    {
+        Value* value = find(section, key);
+        if (value == nullptr) { return true; }
+        if (value->quoted || (value->text != "true" && value->text != "false"))
+        {
+            return fail(value->line, "expected true or false");
+        }
+        out = value->text == "true";
+        return true;
+    }
+
+    // Keys nobody read are most likely typos; say so but carry on.
+    void warn_unused() const
+    {
+        for (const auto& value : values_)
+        {
+            if (!value.used)
+            {
+                printf("Config: %s:%d: unknown key %s.%s\n", path_, value.line, value.section.c_str(), value.key.c_str());
+            }
+        }
+    }
+
+private:
+    Value* find(const char* section, const char* key)
+    {
+        for (auto& value : values_)
+        {
+            if (value.section == section && value.key == key)
+            {
+                value.used = true;
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+
+    bool fail(int line, const char* message) const
+    {
+        printf("Config: %s:%d: %s\n", path_, line, message);
+        return false;
+    }
+
+    const char* path_;
+    std::vector<Value> values_;
+};
+
+} // namespace config_detail
+
+// Reads `path` into `config`, which is left untouched unless the whole
+// file is valid. A missing file is not an error; the defaults stand.
+inline bool load_config(const char* path, DogConfig& config)
+{
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr)
+    {
+        const int error = errno;
+        if (error != ENOENT)
+        {
+            printf("Config: cannot open %s: %s\n", path, strerror(error));
+            return false;
+        }
+        printf("Config: no %s, using defaults\n", path);
+        return true;
+    }
+
+    config_detail::Parser parser(path);
+    const bool parsed = parser.parse(fp);
+    fclose(fp);
+    if (!parsed) { return false; }
+
+    DogConfig next = config;
+    AnalysisThresholds& t = next.thresholds;
+    PursuitSettings& p = next.pursuit;
+    double actuationDelay = p.actuationDelay / 1e6;
+    const bool valid =
+        parser.read("depth", "width", next.depthWidth, 160, 640) &&
+        parser.read("depth", "height", next.depthHeight, 120, 480) &&
+        parser.read("depth", "fps", next.depthFps, 1, 60) &&
+        parser.read("follow", "distance", t.followDistance, 0.5, 10.0) &&
+        parser.read("follow", "deadband", t.followDeadband, 0.0, 1000.0) &&
+        parser.read("follow", "linear_speed", t.followLinear, 0.0, 2.0) &&
+        parser.read("follow", "angular_speed", t.followAngular, 0.0, 2.0) &&
+        parser.read("follow", "distance_gain", p.distanceGain, 0.0, 10.0) &&
+        parser.read("follow", "bearing_gain", p.bearingGain, 0.0, 10.0) &&
+        parser.read("follow", "linear_accel", p.linearAccel, 0.05, 10.0) &&
+        parser.read("follow", "angular_accel", p.angularAccel, 0.05, 20.0) &&
+        parser.read("follow", "actuation_delay", actuationDelay, 0.0, 500.0) &&
+        parser.read("accident", "fall_height", t.fallHeight, 0.0, 1500.0) &&
+        parser.read("accident", "action_probability", t.fallProbability, 0.0, 1.0) &&
+        parser.read("robot", "cmd_vel_rate", next.cmdVelRate, 20.0, 50.0) &&
+        parser.read("robot", "max_data_age", next.maxDataAge, 10.0, 10000.0) &&
+        parser.read("robot", "stop_ramp", next.stopRamp, 0.0, 10000.0) &&
+        parser.read("pipeline", "fallback_delay", next.fallbackDelay, 0, 100000) &&
+        parser.read("pipeline", "model", next.model) &&
+        parser.read("pipeline", "latency_budget", next.latencyBudget, 0.0, 1000.0);
+    if (!valid) { return false; }
+
+    const bool depthMode = (next.depthWidth == 640 && next.depthHeight == 480) ||
+                           (next.depthWidth == 320 && next.depthHeight == 240) ||
+                           (next.depthWidth == 160 && next.depthHeight == 120);
+    if (!depthMode)
+    {
+        printf("Config: %s: depth %dx%d is not a sensor mode; use 640x480, 320x240 or 160x120\n",
+               path, next.depthWidth, next.depthHeight);
+        return false;
+    }
+    p.actuationDelay = static_cast<FrameTime>(actuationDelay * 1e6);
+
+    parser.warn_unused();
+    config = next;
+    return true;
+}
+
+// Tells when the config file was saved. The directory is watched rather
+// than the file, so editors that save by renaming a new file over the old
+// one are seen too.
+class ConfigWatcher
+{
+public:
+    ConfigWatcher() = default;
+
+    ~ConfigWatcher()
+    {
+        if (fd_ >= 0) { close(fd_); }
+    }
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    bool watch(const char* path)
+    {
+        const std::string full = path;
+        const size_t slash = full.rfind('/');
+        const std::string directory = slash == std::string::npos ? "." : full.substr(0, std::max<size_t>(slash, 1));
+        name_ = slash == std::string::npos ? full : full.substr(slash + 1);
+
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0 || inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            printf("Config: cannot watch %s: %s\n", directory.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // Never blocks; true if the file was written since the last call.
+    bool changed()
+    {
+        if (fd_ < 0) { return false; }
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t n;
+        while ((n = read(fd_, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* p = buffer; p < buffer + n;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                changed = changed || (event->len > 0 && name_ == event->name);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+
+private:
+    int fd_{ -1 };
+    std::string name_;
+};
+
+#endif /* CONFIG_HPP */
@@ -0,0 +1,207 @@
+#ifndef DEPTHCODEC_HPP
+#define DEPTHCODEC_HPP
+
+#include <algorithm>
+#include <cstdint>
+
+// Lossless depth compression after Wilson's RVL ("Fast Lossless Depth
+// Image Compression", 2017).
+//
+// Pixels are coded as alternating runs: a count of zero (invalid) pixels,
+// a count of valid pixels, then each valid pixel as the zigzag-coded
+// difference to the previous valid one. Counts and differences use a
+// variable-length code of 4-bit nibbles, 3 value bits plus a continue
+// bit, packed eight to a little-endian 32-bit word. Neighbouring depth
+// pixels rarely differ by more than a few mm, so most pixels take one
+// nibble; the encoder makes a single pass with no tables.
+//
+// Encoder and decoder are streaming: a frame can be fed in any number of
+// row chunks, and the decoder can be asked for any number of pixels at a
+// time. The caller always knows the frame size, so it is not stored.
+
+// Worst case: every pixel its own pair of runs plus a 17-bit difference.
+inline size_t depth_max_encoded_size(size_t pixels)
+{
+    return pixels * 4 + 8;
+}
+
+class DepthEncoder
+{
+public:
+    // `output` must hold depth_max_encoded_size() of the whole frame.
+    void begin(uint8_t* output)
+    {
+        out_ = output;
+        begin_ = output;
+        word_ = 0;
+        nibbles_ = 0;
+        previous_ = 0;
+    }
+
+    void encode(const int16_t* pixels, size_t count)
+    {
+        const int16_t* p = pixels;
+        const int16_t* const end = pixels + count;
+        while (p < end)
+        {
+            const int16_t* zeros = p;
+            while (p < end && *p == 0) { p++; }
+            put(static_cast<uint32_t>(p - zeros));
+
+            const int16_t* values = p;
+            while (p < end && *p != 0) { p++; }
+            put(static_cast<uint32_t>(p - values));
+
+            for (const int16_t* v = values; v < p; v++)
+            {
+                const int32_t delta = *v - previous_;
+                put((static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+                previous_ = *v;
+            }
+        }
+    }
+
+    // Flushes the last word and returns the encoded size in bytes.
+    size_t finish()
+    {
+        if (nibbles_ > 0)
+        {
+            word_ <<= 4 * (8 - nibbles_);
+            store();
+        }
+        return static_cast<size_t>(out_ - begin_);
+    }
+
+private:
+    void put(uint32_t value)
+    {
+        if (value < 8)
+        {
+            word_ = (word_ << 4) | value;
+            if (++nibbles_ == 8) { store(); }
+            return;
+        }
+        do
+        {
+            uint32_t nibble = value & 7;
+            value >>= 3;
+            if (value != 0) { nibble |= 8; }
+            word_ = (word_ << 4) | nibble;
+            if (++nibbles_ == 8) { store(); }
+        } while (value != 0);
+    }
+
+    void store()
+    {
+        const uint32_t w = word_;
+        out_[0] = static_cast<uint8_t>(w);
+        out_[1] = static_cast<uint8_t>(w >> 8);
+        out_[2] = static_cast<uint8_t>(w >> 16);
+        out_[3] = static_cast<uint8_t>(w >> 24);
+        out_ += 4;
+        word_ = 0;
+        nibbles_ = 0;
+    }
+
+    uint8_t* out_{ nullptr };
+    uint8_t* begin_{ nullptr };
+    uint32_t word_{ 0 };
+    int nibbles_{ 0 };
+    int32_t previous_{ 0 };
+};
+
+class DepthDecoder
+{
+public:
+    void begin(const uint8_t* input, size_t bytes)
+    {
+        in_ = input;
+        end_ = input + bytes;
+        word_ = 0;
+        nibbles_ = 0;
+        previous_ = 0;
+        zeros_ = 0;
+        values_ = 0;
+    }
+
+    // Decodes the next `count` pixels; false on truncated or corrupt input.
+    bool decode(int16_t* output, size_t count)
+    {
+        while (count > 0)
+        {
+            if (zeros_ == 0 && values_ == 0)
+            {
+                if (!get(zeros_) || !get(values_)) { return false; }
+                continue;
+            }
+
+            const size_t zeros = std::min<size_t>(zeros_, count);
+            std::fill(output, output + zeros, static_cast<int16_t>(0));
+            output += zeros;
+            count -= zeros;
+            zeros_ -= static_cast<uint32_t>(zeros);
+
+            const size_t values = std::min<size_t>(zeros_ == 0 ? values_ : 0, count);
+            for (size_t i = 0; i < values; i++)
+            {
+                uint32_t code;
+                if (!get(code)) { return false; }
+                previous_ += static_cast<int32_t>(code >> 1) ^ -static_cast<int32_t>(code & 1);
+                *output++ = static_cast<int16_t>(previous_);
+            }
+            count -= values;
+            values_ -= static_cast<uint32_t>(values);
+        }
+        return true;
+    }
+
+private:
+    bool get(uint32_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 32; shift += 3)
+        {
+            if (nibbles_ == 0)
+            {
+                if (end_ - in_ < 4) { return false; }
+                word_ = static_cast<uint32_t>(in_[0]) | static_cast<uint32_t>(in_[1]) << 8 |
+                        static_cast<uint32_t>(in_[2]) << 16 | static_cast<uint32_t>(in_[3]) << 24;
+                in_ += 4;
+                nibbles_ = 8;
+            }
+            const uint32_t nibble = word_ >> 28;
+            word_ <<= 4;
+            nibbles_--;
+
+            value |= (nibble & 7) << shift;
+            if ((nibble & 8) == 0) { return true; }
+        }
+        return false;
+    }
+
+    const uint8_t* in_{ nullptr };
+    const uint8_t* end_{ nullptr };
+    uint32_t word_{ 0 };
+    int nibbles_{ 0 };
+    int32_t previous_{ 0 };
+    uint32_t zeros_{ 0 };
+    uint32_t values_{ 0 };
+};
+
+// Whole-frame helpers.
+inline size_t depth_encode(const int16_t* pixels, size_t count, uint8_t* output)
+{
+    DepthEncoder encoder;
+    encoder.begin(output);
+    encoder.encode(pixels, count);
+    return encoder.finish();
+}
+
+inline bool depth_decode(const uint8_t* input, size_t bytes, int16_t* pixels, size_t count)
+{
+    DepthDecoder decoder;
+    decoder.begin(input, bytes);
+    return decoder.decode(pixels, count);
+}
+
+#endif /* DEPTHCODEC_HPP */
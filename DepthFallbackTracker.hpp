@@ -0,0 +1,415 @@
+#ifndef DEPTHFALLBACKTRACKER_HPP
+#define DEPTHFALLBACKTRACKER_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include "FrameArena.hpp"
+#include "ParallelBands.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// License-free person detector on raw depth, used when the Orbbec body
+// tracker gives nothing.
+//
+// Per frame: background subtraction against a slowly adapting far-depth
+// model (row bands in parallel), connected components on a downsampled
+// foreground grid, then a geodesic extremity search inside every blob. The
+// highest extremity is the head, the two lowest are the feet, the rest are
+// hands; the blob centroid is the base spine and centre of mass. Only those
+// joints are reported, with low confidence, which is enough for the fall
+// and follow logic.
+class DepthFallbackTracker
+{
+public:
+    explicit DepthFallbackTracker(int gridStep = 4)
+        : step_(std::max(1, gridStep))
+    {}
+
+    // Fills `out` with the detected bodies and returns their number. The
+    // grid and search buffers come from `arena` and are dead once this
+    // returns.
+    int process(const int16_t* depth, int width, int height, astra_body_list_t& out, FrameArena& arena)
+    {
+        TRACE_ZONE("DepthFallbackTracker::process");
+        prepare(width, height);
+        const size_t cells = static_cast<size_t>(gridWidth_) * gridHeight_;
+        grid_ = arena.allocate_array<int16_t>(cells);
+        labels_ = arena.allocate_array<int>(cells);
+        geodesic_ = arena.allocate_array<int>(cells);
+        queue_ = arena.allocate_array<int>(cells);
+        cells_ = arena.allocate_array<int>(cells);
+        subtract_background(depth);
+        label_blobs();
+        out.count = 0;
+
+        for (auto& blob : blobs_)
+        {
+            if (out.count == ASTRA_MAX_BODIES) { break; }
+            astra_body_t& body = out.bodies[out.count];
+            if (build_body(blob, body))
+            {
+                out.count++;
+            }
+        }
+        assign_ids(out);
+        return out.count;
+    }
+
+    // Forget the background, e.g. after the robot moved.
+    void reset_background()
+    {
+        std::fill(background_.begin(), background_.end(), 0.f);
+    }
+
+    // Nominal Astra depth field of view, in radians.
+    void set_field_of_view(float horizontal, float vertical)
+    {
+        hfov_ = horizontal;
+        vfov_ = vertical;
+    }
+
+private:
+    struct Blob
+    {
+        int area{ 0 };
+        float sumX{ 0.f };
+        float sumY{ 0.f };
+        float sumDepth{ 0.f };
+        int firstCell{ 0 };   // cells are cells_[firstCell, firstCell + area)
+    };
+
+    struct Extremity
+    {
+        int cell;
+        float x;
+        float y;
+    };
+
+    void prepare(int width, int height)
+    {
+        if (width == width_ && height == height_)
+        {
+            return;
+        }
+        width_ = width;
+        height_ = height;
+        gridWidth_ = width / step_;
+        gridHeight_ = height / step_;
+
+        background_.assign(width * height, 0.f);
+        tracks_.clear();
+    }
+
+    void subtract_background(const int16_t* depth)
+    {
+        // Captures no more than std::function stores without allocating.
+        bands_.run(gridHeight_, [this, depth](int begin, int end, int) {
+            const int width = width_;
+            const int step = step_;
+            const int gridWidth = gridWidth_;
+            const float threshold = foregroundThreshold_;
+            const float rate = backgroundRate_;
+            for (int gy = begin; gy < end; gy++)
+            {
+                for (int gx = 0; gx < gridWidth; gx++)
+                {
+                    int votes = 0;
+                    int nearest = 0;
+                    for (int y = gy * step; y < gy * step + step; y++)
+                    {
+                        for (int x = gx * step; x < gx * step + step; x++)
+                        {
+                            const int i = x + y * width;
+                            const int d = depth[i];
+                            if (d <= 0) { continue; }
+
+                            float& bg = background_[i];
+                            if (bg == 0.f || d > bg)
+                            {
+                                bg = static_cast<float>(d);
+                            }
+                            else if (d < bg - threshold && d >= minDepth_ && d <= maxDepth_)
+                            {
+                                votes++;
+                                nearest = nearest == 0 ? d : std::min(nearest, d);
+                                continue;
+                            }
+                            else
+                            {
+                                bg += rate * (d - bg);
+                            }
+                        }
+                    }
+                    // A cell is foreground when most of its pixels are.
+                    grid_[gx + gy * gridWidth] = votes * 2 > step * step ? static_cast<int16_t>(nearest) : 0;
+                }
+            }
+        });
+    }
+
+    void label_blobs()
+    {
+        const int cells = gridWidth_ * gridHeight_;
+        std::fill(labels_, labels_ + cells, -1);
+        blobs_.clear();
+
+        int cellCount = 0;
+        for (int seed = 0; seed < cells; seed++)
+        {
+            if (grid_[seed] == 0 || labels_[seed] >= 0) { continue; }
+
+            Blob blob;
+            blob.firstCell = cellCount;
+            const int label = static_cast<int>(blobs_.size());
+            int head = 0, tail = 0;
+            queue_[tail++] = seed;
+            labels_[seed] = label;
+            while (head < tail)
+            {
+                const int c = queue_[head++];
+                const int cx = c % gridWidth_;
+                const int cy = c / gridWidth_;
+                cells_[cellCount++] = c;
+                blob.area++;
+                blob.sumX += cx;
+                blob.sumY += cy;
+                blob.sumDepth += grid_[c];
+
+                const int neighbours[4] = { c - 1, c + 1, c - gridWidth_, c + gridWidth_ };
+                const bool inside[4] = { cx > 0, cx + 1 < gridWidth_, cy > 0, cy + 1 < gridHeight_ };
+                for (int k = 0; k < 4; k++)
+                {
+                    const int n = neighbours[k];
+                    if (!inside[k] || grid_[n] == 0 || labels_[n] >= 0) { continue; }
+                    if (std::abs(grid_[n] - grid_[c]) > continuity_) { continue; }
+                    labels_[n] = label;
+                    queue_[tail++] = n;
+                }
+            }
+
+            blobs_.push_back(blob);
+        }
+
+        // Drop specks, largest first.
+        const int minCells = std::max(1, minPixels_ / (step_ * step_));
+        blobs_.erase(std::remove_if(blobs_.begin(), blobs_.end(),
+                                    [&](const Blob& b) { return b.area < minCells; }),
+                     blobs_.end());
+        std::sort(blobs_.begin(), blobs_.end(),
+                  [](const Blob& a, const Blob& b) { return a.area > b.area; });
+    }
+
+    // Multi-source BFS over the blob; returns the cell farthest from all sources.
+    int farthest_cell(const Blob& blob, const std::vector<int>& sources, int& distance)
+    {
+        const int* cells = cells_ + blob.firstCell;
+        for (int i = 0; i < blob.area; i++) { geodesic_[cells[i]] = -1; }
+        const int label = labels_[cells[0]];
+
+        int head = 0, tail = 0;
+        for (int s : sources)
+        {
+            geodesic_[s] = 0;
+            queue_[tail++] = s;
+        }
+
+        int last = sources.front();
+        while (head < tail)
+        {
+            const int c = queue_[head++];
+            last = c;
+            const int cx = c % gridWidth_;
+            const int cy = c / gridWidth_;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const int nx = cx + dx, ny = cy + dy;
+                    if (nx < 0 || ny < 0 || nx >= gridWidth_ || ny >= gridHeight_) { continue; }
+                    const int n = nx + ny * gridWidth_;
+                    if (labels_[n] != label || geodesic_[n] >= 0) { continue; }
+                    geodesic_[n] = geodesic_[c] + 1;
+                    queue_[tail++] = n;
+                }
+            }
+        }
+
+        distance = geodesic_[last];
+        return last;
+    }
+
+    astra_vector3f_t to_world(float px, float py, float depth) const
+    {
+        const float fx = 0.5f * width_ / std::tan(0.5f * hfov_);
+        const float fy = 0.5f * height_ / std::tan(0.5f * vfov_);
+        return astra_vector3f_t{
+            (px - 0.5f * width_) / fx * depth,
+            (0.5f * height_ - py) / fy * depth,
+            depth };
+    }
+
+    void set_joint(astra_body_t& body, int type, float px, float py, float depth) const
+    {
+        astra_joint_t& joint = body.joints[type];
+        joint.status = ASTRA_JOINT_STATUS_LOW_CONFIDENCE;
+        joint.depthPosition.x = px;
+        joint.depthPosition.y = py;
+        joint.worldPosition = to_world(px, py, depth);
+    }
+
+    bool build_body(const Blob& blob, astra_body_t& body)
+    {
+        std::memset(&body, 0, sizeof(body));
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            body.joints[j].type = static_cast<astra_joint_type_t>(j);
+            body.joints[j].status = ASTRA_JOINT_STATUS_NOT_TRACKED;
+        }
+
+        const float half = 0.5f * step_;
+        const float cx = blob.sumX / blob.area;
+        const float cy = blob.sumY / blob.area;
+        const float cdepth = blob.sumDepth / blob.area;
+
+        // Start from the blob cell nearest the centroid.
+        const int* cells = cells_ + blob.firstCell;
+        int centre = cells[0];
+        float best = 1e9f;
+        for (int i = 0; i < blob.area; i++)
+        {
+            const int c = cells[i];
+            const float dx = c % gridWidth_ - cx;
+            const float dy = c / gridWidth_ - cy;
+            if (dx * dx + dy * dy < best)
+            {
+                best = dx * dx + dy * dy;
+                centre = c;
+            }
+        }
+
+        std::vector<int>& sources = sources_;
+        sources.assign(1, centre);
+        Extremity found[5];
+        int foundCount = 0;
+        const int minReach = std::max(2, minLimbPixels_ / step_);
+        while (foundCount < 5)
+        {
+            int distance = 0;
+            const int cell = farthest_cell(blob, sources, distance);
+            if (distance < minReach) { break; }
+            found[foundCount++] = Extremity{ cell, (cell % gridWidth_) * step_ + half, (cell / gridWidth_) * step_ + half };
+            sources.push_back(cell);
+        }
+        if (foundCount < 2) { return false; }
+
+        std::sort(found, found + foundCount, [](const Extremity& a, const Extremity& b) { return a.y < b.y; });
+
+        const float px = cx * step_ + half;
+        const float py = cy * step_ + half;
+        body.centerOfMass = to_world(px, py, cdepth);
+        set_joint(body, ASTRA_JOINT_BASE_SPINE, px, py, cdepth);
+
+        const Extremity& head = found[0];
+        set_joint(body, ASTRA_JOINT_HEAD, head.x, head.y, grid_[head.cell]);
+
+        // Bottom one or two extremities are feet, anything between head and feet are hands.
+        const int feet = foundCount >= 3 ? 2 : 1;
+        for (int i = 0; i < feet; i++)
+        {
+            const Extremity& e = found[foundCount - 1 - i];
+            const bool left = feet == 1 || e.x < found[foundCount - 2 + i].x;
+            set_joint(body, left ? ASTRA_JOINT_LEFT_FOOT : ASTRA_JOINT_RIGHT_FOOT, e.x, e.y, grid_[e.cell]);
+        }
+        for (int i = 1; i < foundCount - feet; i++)
+        {
+            const Extremity& e = found[i];
+            set_joint(body, e.x < px ? ASTRA_JOINT_LEFT_HAND : ASTRA_JOINT_RIGHT_HAND, e.x, e.y, grid_[e.cell]);
+        }
+
+        body.status = ASTRA_BODY_STATUS_TRACKING;
+        body.features = ASTRA_BODY_TRACKING_JOINTS;
+        return true;
+    }
+
+    // Keeps ids stable by matching each body to the nearest previous centroid.
+    void assign_ids(astra_body_list_t& list)
+    {
+        std::vector<Track>& previous = previousTracks_;
+        previous.swap(tracks_);
+        tracks_.clear();
+        for (int b = 0; b < list.count; b++)
+        {
+            astra_body_t& body = list.bodies[b];
+            const astra_vector3f_t& com = body.centerOfMass;
+            int match = -1;
+            float best = maxMatchDistance_ * maxMatchDistance_;
+            for (size_t t = 0; t < previous.size(); t++)
+            {
+                const float dx = previous[t].x - com.x;
+                const float dz = previous[t].z - com.z;
+                if (previous[t].id != ASTRA_INVALID_BODY_ID && dx * dx + dz * dz < best)
+                {
+                    best = dx * dx + dz * dz;
+                    match = static_cast<int>(t);
+                }
+            }
+
+            if (match >= 0)
+            {
+                body.id = previous[match].id;
+                previous[match].id = ASTRA_INVALID_BODY_ID;
+            }
+            else
+            {
+                body.id = nextId_;
+                body.status = ASTRA_BODY_STATUS_TRACKING_STARTED;
+                nextId_ = nextId_ == ASTRA_MAX_BODY_ID ? ASTRA_MIN_BODY_ID : nextId_ + 1;
+            }
+            tracks_.push_back(Track{ body.id, com.x, com.z });
+        }
+    }
+
+    struct Track
+    {
+        astra_body_id_t id;
+        float x;
+        float z;
+    };
+
+    int step_;
+    int width_{ 0 };
+    int height_{ 0 };
+    int gridWidth_{ 0 };
+    int gridHeight_{ 0 };
+
+    float hfov_{ 1.0472f };  // 60 degrees
+    float vfov_{ 0.8639f };  // 49.5 degrees
+    float foregroundThreshold_{ 150.f }; // mm closer than the background
+    float backgroundRate_{ 0.02f };
+    int minDepth_{ 400 };
+    int maxDepth_{ 6000 };
+    int continuity_{ 200 };    // mm between neighbouring cells of one blob
+    int minPixels_{ 3000 };    // at full resolution
+    int minLimbPixels_{ 24 };  // geodesic reach of an extremity, full-res pixels
+    float maxMatchDistance_{ 600.f };
+
+    std::vector<float> background_;
+    // Per-frame scratch in the caller's arena, one entry per grid cell.
+    int16_t* grid_{ nullptr };
+    int* labels_{ nullptr };
+    int* geodesic_{ nullptr };
+    int* queue_{ nullptr };
+    int* cells_{ nullptr };
+    std::vector<int> sources_;
+    std::vector<Blob> blobs_;
+    std::vector<Track> tracks_;
+    std::vector<Track> previousTracks_;
+    astra_body_id_t nextId_{ ASTRA_MIN_BODY_ID };
+
+    ParallelBands bands_;
+};
+
+#endif /* DEPTHFALLBACKTRACKER_HPP */
@@ -0,0 +1,196 @@
+#ifndef FLOORFRAME_HPP
+#define FLOORFRAME_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include "FrameClock.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Gravity-aligned, floor-origin coordinate frame.
+//
+// Canonical coordinates are in mm: +Y is up along the floor normal and is
+// the height above the floor, X is the camera's x axis projected onto the
+// floor, Z completes the right-handed frame (forward along the floor). The
+// origin is the point on the floor right below the camera, so distances in
+// the XZ plane are ground distances from the robot.
+//
+// The rotation is rebuilt once per frame from the SDK floor plane. When the
+// SDK loses the floor the last plane is kept for `holdTime`, after which the
+// floor is re-estimated from the lowest tracked foot along the last known
+// normal (or the camera's +Y before any floor was seen).
+class FloorFrame
+{
+public:
+    explicit FloorFrame(float defaultCameraHeight = 600.f, FrameTime holdTime = 1000000000LL)
+        : defaultHeight_(defaultCameraHeight),
+          holdTime_(holdTime)
+    {
+        set_plane(0.f, 1.f, 0.f, defaultHeight_);
+    }
+
+    void update(const astra_plane_t& plane, bool detected, FrameTime now,
+                const astra_body_t* const* bodies, int count)
+    {
+        const float len = std::sqrt(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+        if (detected && len > 1e-6f)
+        {
+            // Orient the normal so the camera is above the floor.
+            const float sign = plane.d >= 0.f ? 1.f : -1.f;
+            set_plane(sign * plane.a / len, sign * plane.b / len, sign * plane.c / len, sign * plane.d / len);
+            lastDetected_ = now;
+            everDetected_ = true;
+            estimated_ = false;
+            return;
+        }
+
+        estimated_ = true;
+        if (everDetected_ && now - lastDetected_ <= holdTime_)
+        {
+            return;
+        }
+
+        float lowest = 0.f;
+        if (lowest_foot(bodies, count, lowest))
+        {
+            set_plane(upX_, upY_, upZ_, -lowest);
+        }
+        else if (!everDetected_)
+        {
+            set_plane(0.f, 1.f, 0.f, defaultHeight_);
+        }
+    }
+
+    // Writes canonical copies of the bodies: world positions and centre of
+    // mass are transformed, everything else is copied through.
+    void transform(const astra_body_t* const* bodies, int count, astra_body_t* out)
+    {
+        const int n = count * ASTRA_MAX_JOINTS;
+        for (int b = 0; b < count; b++)
+        {
+            out[b] = *bodies[b];
+            for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+            {
+                const astra_vector3f_t& p = bodies[b]->joints[j].worldPosition;
+                px_[b * ASTRA_MAX_JOINTS + j] = p.x;
+                py_[b * ASTRA_MAX_JOINTS + j] = p.y;
+                pz_[b * ASTRA_MAX_JOINTS + j] = p.z;
+            }
+        }
+
+        const astra_matrix3x3_t& m = basis_;
+        const float ty = height_;
+        for (int i = 0; i < n; i++)
+        {
+            const float x = px_[i], y = py_[i], z = pz_[i];
+            qx_[i] = m.m00 * x + m.m10 * y + m.m20 * z;
+            qy_[i] = m.m01 * x + m.m11 * y + m.m21 * z + ty;
+            qz_[i] = m.m02 * x + m.m12 * y + m.m22 * z;
+        }
+
+        for (int b = 0; b < count; b++)
+        {
+            for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+            {
+                astra_vector3f_t& q = out[b].joints[j].worldPosition;
+                q.x = qx_[b * ASTRA_MAX_JOINTS + j];
+                q.y = qy_[b * ASTRA_MAX_JOINTS + j];
+                q.z = qz_[b * ASTRA_MAX_JOINTS + j];
+            }
+            out[b].centerOfMass = to_canonical(bodies[b]->centerOfMass);
+        }
+    }
+
+    astra_vector3f_t to_canonical(const astra_vector3f_t& p) const
+    {
+        const astra_matrix3x3_t& m = basis_;
+        return astra_vector3f_t{
+            m.m00 * p.x + m.m10 * p.y + m.m20 * p.z,
+            m.m01 * p.x + m.m11 * p.y + m.m21 * p.z + height_,
+            m.m02 * p.x + m.m12 * p.y + m.m22 * p.z };
+    }
+
+    // Canonical axes expressed in camera coordinates, laid out like
+    // astra::Matrix3x3 (x_axis(), y_axis(), z_axis() are the columns).
+    const astra_matrix3x3_t& basis() const { return basis_; }
+    float camera_height() const { return height_; }
+    bool is_estimated() const { return estimated_; }
+
+    // The floor plane in canonical coordinates.
+    static astra_plane_t canonical_floor()
+    {
+        return astra_plane_t{ 0.f, 1.f, 0.f, 0.f };
+    }
+
+private:
+    void set_plane(float nx, float ny, float nz, float d)
+    {
+        upX_ = nx;
+        upY_ = ny;
+        upZ_ = nz;
+        height_ = d;
+
+        // X: camera x axis projected onto the floor; falls back to camera z
+        // if the camera looks straight along the normal's sideways axis.
+        float xx = 1.f - nx * nx, xy = -nx * ny, xz = -nx * nz;
+        float len = std::sqrt(xx * xx + xy * xy + xz * xz);
+        if (len < 1e-3f)
+        {
+            xx = -nz * nx;
+            xy = -nz * ny;
+            xz = 1.f - nz * nz;
+            len = std::sqrt(xx * xx + xy * xy + xz * xz);
+        }
+        xx /= len;
+        xy /= len;
+        xz /= len;
+
+        // Z = X x Y
+        const float zx = xy * nz - xz * ny;
+        const float zy = xz * nx - xx * nz;
+        const float zz = xx * ny - xy * nx;
+
+        basis_.m00 = xx; basis_.m10 = xy; basis_.m20 = xz;
+        basis_.m01 = nx; basis_.m11 = ny; basis_.m21 = nz;
+        basis_.m02 = zx; basis_.m12 = zy; basis_.m22 = zz;
+    }
+
+    bool lowest_foot(const astra_body_t* const* bodies, int count, float& lowest) const
+    {
+        bool found = false;
+        for (int b = 0; b < count; b++)
+        {
+            const int feet[2] = { ASTRA_JOINT_LEFT_FOOT, ASTRA_JOINT_RIGHT_FOOT };
+            for (int foot : feet)
+            {
+                const astra_joint_t& joint = bodies[b]->joints[foot];
+                if (joint.status != ASTRA_JOINT_STATUS_TRACKED) { continue; }
+                const astra_vector3f_t& p = joint.worldPosition;
+                const float along = upX_ * p.x + upY_ * p.y + upZ_ * p.z;
+                if (!found || along < lowest) { lowest = along; }
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    float defaultHeight_;
+    FrameTime holdTime_;
+    FrameTime lastDetected_{ 0 };
+    bool everDetected_{ false };
+    bool estimated_{ true };
+
+    float upX_{ 0.f };
+    float upY_{ 1.f };
+    float upZ_{ 0.f };
+    float height_{ 0.f };
+    astra_matrix3x3_t basis_;
+
+    float px_[ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS];
+    float py_[ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS];
+    float pz_[ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS];
+    float qx_[ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS];
+    float qy_[ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS];
+    float qz_[ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS];
+};
+
+#endif /* FLOORFRAME_HPP */
@@ -0,0 +1,203 @@
+#ifndef FRAMEARENA_HPP
+#define FRAMEARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for scratch memory that lives exactly one frame.
+//
+// allocate() hands out aligned pieces of one block; reset() at the start
+// of the next frame takes them all back at once. Nothing is ever freed on
+// its own and nothing is constructed or destroyed, so only trivially
+// destructible types belong here. A frame that needs more than the block
+// spills into extra chunks from the heap, and the next reset() replaces
+// them with a single block big enough for that frame, so after the first
+// few frames the arena never calls malloc again.
+//
+// Not thread-safe; parallel stages take one arena per band from
+// FrameArenas.
+class FrameArena
+{
+public:
+    // Where a scope started; see FrameArenaScope.
+    struct Mark
+    {
+        size_t chunk;
+        size_t offset;
+        size_t base;
+    };
+
+    explicit FrameArena(size_t capacity = 256 * 1024)
+    {
+        chunks_.push_back(Chunk(std::max<size_t>(capacity, 1024)));
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // `bytes` bytes aligned to `align`, a power of two no larger than the
+    // alignment of operator new.
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    {
+        for (;;)
+        {
+            Chunk& chunk = chunks_[current_];
+            const size_t start = (offset_ + align - 1) & ~(align - 1);
+            if (start + bytes <= chunk.size)
+            {
+                offset_ = start + bytes;
+                frameHighWater_ = std::max(frameHighWater_, base_ + offset_);
+                return chunk.data.get() + start;
+            }
+
+            base_ += chunk.size;
+            if (current_ + 1 == chunks_.size())
+            {
+                chunks_.push_back(Chunk(std::max(bytes + align, chunks_[0].size)));
+            }
+            current_++;
+            offset_ = 0;
+        }
+    }
+
+    // Uninitialised room for `count` objects of T.
+    template <typename T>
+    T* allocate_array(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    Mark mark() const { return Mark{ current_, offset_, base_ }; }
+
+    // Takes back everything allocated since `m`.
+    void rewind(const Mark& m)
+    {
+        current_ = m.chunk;
+        offset_ = m.offset;
+        base_ = m.base;
+    }
+
+    // Takes back everything. If the frame spilled over, the spare chunks
+    // are merged into one block a quarter larger than what it needed.
+    void reset()
+    {
+        highWater_ = std::max(highWater_, frameHighWater_);
+        if (chunks_.size() > 1)
+        {
+            const size_t capacity = std::max(chunks_[0].size, frameHighWater_ + frameHighWater_ / 4);
+            chunks_.clear();
+            chunks_.push_back(Chunk(capacity));
+            grows_++;
+        }
+        current_ = 0;
+        offset_ = 0;
+        base_ = 0;
+        frameHighWater_ = 0;
+    }
+
+    size_t used() const { return base_ + offset_; }
+    size_t capacity() const { return chunks_[0].size; }
+    // Most bytes any single frame has needed so far.
+    size_t high_water() const { return std::max(highWater_, frameHighWater_); }
+    int grows() const { return grows_; }
+
+private:
+    struct Chunk
+    {
+        explicit Chunk(size_t bytes)
+            : data(new uint8_t[bytes]), size(bytes)
+        {}
+
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t current_{ 0 };
+    size_t offset_{ 0 };
+    size_t base_{ 0 };          // bytes in the chunks before current_
+    size_t frameHighWater_{ 0 };
+    size_t highWater_{ 0 };
+    int grows_{ 0 };
+};
+
+// Gives back what was allocated inside the scope when it ends, for
+// scratch that is needed only part of a frame, e.g. once per body.
+class FrameArenaScope
+{
+public:
+    explicit FrameArenaScope(FrameArena& arena)
+        : arena_(arena), mark_(arena.mark())
+    {}
+
+    ~FrameArenaScope() { arena_.rewind(mark_); }
+
+    FrameArenaScope(const FrameArenaScope&) = delete;
+    FrameArenaScope& operator=(const FrameArenaScope&) = delete;
+
+private:
+    FrameArena& arena_;
+    FrameArena::Mark mark_;
+};
+
+// The arenas of one frame: band 0 belongs to the thread running the
+// frame, bands 1.. to the ParallelBands workers of the same number, so a
+// parallel stage allocates without locks. reset() once per frame, before
+// any stage runs.
+class FrameArenas
+{
+public:
+    explicit FrameArenas(size_t capacity = 256 * 1024)
+        : capacity_(capacity)
+    {
+        ensure_bands(1);
+    }
+
+    // Call from the frame thread before a parallel stage that uses
+    // `count` bands; only the first call for a given count allocates.
+    void ensure_bands(int count)
+    {
+        while (static_cast<int>(arenas_.size()) < count)
+        {
+            arenas_.emplace_back(new FrameArena(capacity_));
+        }
+    }
+
+    FrameArena& band(int band) { return *arenas_[band]; }
+    FrameArena& frame() { return *arenas_[0]; }
+    int band_count() const { return static_cast<int>(arenas_.size()); }
+
+    void reset()
+    {
+        for (auto& arena : arenas_) { arena->reset(); }
+    }
+
+    size_t high_water() const
+    {
+        size_t total = 0;
+        for (const auto& arena : arenas_) { total += arena->high_water(); }
+        return total;
+    }
+
+    void print_report() const
+    {
+        for (int b = 0; b < band_count(); b++)
+        {
+            const FrameArena& arena = *arenas_[b];
+            printf("FrameArena: band %d high water %zu KB of %zu KB, grew %d times\n",
+                   b, arena.high_water() / 1024, arena.capacity() / 1024, arena.grows());
+        }
+    }
+
+private:
+    size_t capacity_;
+    std::vector<std::unique_ptr<FrameArena>> arenas_;
+};
+
+#endif /* FRAMEARENA_HPP */
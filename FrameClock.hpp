@@ -0,0 +1,22 @@
+#ifndef FRAMECLOCK_HPP
+#define FRAMECLOCK_HPP
+
+#include <chrono>
+#include <cstdint>
+
+// Frame timestamps are monotonic nanoseconds. Live frames are stamped from
+// the steady clock when they arrive; recorded frames carry their own stamps.
+using FrameTime = std::int64_t;
+
+inline FrameTime frame_clock_now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline double frame_time_seconds(FrameTime t)
+{
+    return t * 1e-9;
+}
+
+#endif /* FRAMECLOCK_HPP */
@@ -0,0 +1,185 @@
+#ifndef FRAMEKERNELS_HPP
+#define FRAMEKERNELS_HPP
+
+#include <astra/Vector3f.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Per-pixel work done on every frame, kept free of SFML and of anything
+// that needs the Astra runtime so bench_kernels can run it on any Linux
+// box. The viewer wraps these; the lit depth functions are the SDK
+// sample's LitDepthVisualizer as plain functions over caller-owned maps.
+
+struct Rgba
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+// Display colour of body mask id `bodyId`; 0 (no body) is transparent.
+inline Rgba body_mask_color(uint8_t bodyId)
+{
+    static const Rgba palette[24] = {
+        { 0x00, 0x88, 0x00, 0xFF }, { 0x00, 0x00, 0xFF, 0xFF }, { 0x88, 0x00, 0x00, 0xFF },
+        { 0x00, 0xFF, 0x00, 0xFF }, { 0x00, 0x00, 0x88, 0xFF }, { 0xFF, 0x00, 0x00, 0xFF },
+        { 0xFF, 0x88, 0x00, 0xFF }, { 0xFF, 0x00, 0xFF, 0xFF }, { 0x88, 0x00, 0xFF, 0xFF },
+        { 0x00, 0xFF, 0xFF, 0xFF }, { 0x00, 0xFF, 0x88, 0xFF }, { 0xFF, 0xFF, 0x00, 0xFF },
+        { 0x00, 0x88, 0x88, 0xFF }, { 0x00, 0x88, 0xFF, 0xFF }, { 0x88, 0x88, 0x00, 0xFF },
+        { 0x88, 0xFF, 0x00, 0xFF }, { 0x88, 0x00, 0x88, 0xFF }, { 0xFF, 0x00, 0x88, 0xFF },
+        { 0xFF, 0x88, 0x88, 0xFF }, { 0xFF, 0x88, 0xFF, 0xFF }, { 0x88, 0x88, 0xFF, 0xFF },
+        { 0x88, 0xFF, 0xFF, 0xFF }, { 0x88, 0xFF, 0x88, 0xFF }, { 0xFF, 0xFF, 0x88, 0xFF },
+    };
+    // Case 0 could mean bodyId == 24 or above due to the "% 24".
+    return bodyId == 0 ? Rgba{ 0x00, 0x00, 0x00, 0x00 } : palette[bodyId % 24];
+}
+
+// Grey RGBA view of a depth image, mm modulo 255.
+inline void depth_to_rgba(const int16_t* depth, int width, int height, uint8_t* rgba)
+{
+    const int length = width * height;
+    for (int i = 0; i < length; i++)
+    {
+        const uint8_t value = depth[i] % 255;
+        rgba[i * 4] = value;
+        rgba[i * 4 + 1] = value;
+        rgba[i * 4 + 2] = value;
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+// RGBA overlay of the body and floor masks: bodies in their colour, the
+// floor translucent blue, everything else transparent.
+inline void masks_to_rgba(const uint8_t* bodyMask, const uint8_t* floorMask, int width, int height, uint8_t* rgba)
+{
+    const int length = width * height;
+    for (int i = 0; i < length; i++)
+    {
+        Rgba color = { 0x00, 0x00, 0x00, 0x00 };
+        if (bodyMask[i] != 0)
+        {
+            color = body_mask_color(bodyMask[i]);
+        }
+        else if (floorMask[i] != 0)
+        {
+            color = { 0x00, 0x00, 0xFF, 0x88 };
+        }
+        std::memcpy(rgba + i * 4, &color, 4);
+    }
+}
+
+// Surface normals of a point map from the four neighbours of each point;
+// zero at the border and next to holes.
+inline void lit_depth_normals(const astra::Vector3f* points, int width, int height, astra::Vector3f* normals)
+{
+    std::fill(normals, normals + width, astra::Vector3f::zero());
+    for (int y = 1; y < height - 1; y++)
+    {
+        astra::Vector3f* normal = normals + y * width;
+        const astra::Vector3f* p = points + y * width;
+        normal[0] = astra::Vector3f::zero();
+        normal[width - 1] = astra::Vector3f::zero();
+        for (int x = 1; x < width - 1; x++)
+        {
+            const astra::Vector3f& point = p[x];
+            const astra::Vector3f& left = p[x - 1];
+            const astra::Vector3f& right = p[x + 1];
+            const astra::Vector3f& up = p[x - width];
+            const astra::Vector3f& down = p[x + width];
+            if (point.z == 0 || right.z == 0 || down.z == 0 || left.z == 0 || up.z == 0)
+            {
+                normal[x] = astra::Vector3f::zero();
+                continue;
+            }
+
+            const astra::Vector3f vr = right - point;
+            const astra::Vector3f vd = down - point;
+            const astra::Vector3f vl = left - point;
+            const astra::Vector3f vu = up - point;
+            astra::Vector3f sum = vd.cross(vr);
+            sum += vl.cross(vd);
+            sum += vu.cross(vl);
+            sum += vr.cross(vu);
+            normal[x] = astra::Vector3f::normalize(sum);
+        }
+    }
+    std::fill(normals + (height - 1) * width, normals + height * width, astra::Vector3f::zero());
+}
+
+// 3x3 box sum with a running row total, as in the SDK sample.
+inline void box_blur_fast(const astra::Vector3f* in, astra::Vector3f* out, int width, int height)
+{
+    const astra::Vector3f* inRow = in + width;
+    astra::Vector3f* outRow = out;
+    std::memset(static_cast<void*>(out), 0, sizeof(astra::Vector3f) * width * height);
+
+    for (int y = 1; y < height; y++, inRow += width, outRow += width)
+    {
+        const astra::Vector3f* inLeft = inRow - 1;
+        const astra::Vector3f* inMid = inRow + 1;
+        astra::Vector3f* outUp = outRow;
+        astra::Vector3f* outMid = outRow + width;
+        astra::Vector3f total = *inLeft + *inRow;
+        for (int x = 1; x < width; x++)
+        {
+            total += *inMid;
+            *outUp += total;
+            *outMid += total;
+            total -= *inLeft;
+            ++inLeft;
+            ++inMid;
+            ++outUp;
+            ++outMid;
+        }
+    }
+}
+
+// Diffuse plus ambient shading of the blurred normals, fading with depth.
+inline void lit_depth_shade(const astra::Vector3f* points, const astra::Vector3f* normals, int width, int height,
+                            const astra::Vector3f& light, uint8_t* rgb)
+{
+    const float lightColor = 210.f;
+    const float ambientColor = 30.f;
+    const int length = width * height;
+    for (int i = 0; i < length; i++, rgb += 3)
+    {
+        const float depth = points[i].z;
+        if (depth == 0)
+        {
+            rgb[0] = rgb[1] = rgb[2] = 0;
+            continue;
+        }
+
+        const astra::Vector3f normal = astra::Vector3f::normalize(normals[i]);
+        const float fade = 1.0f - 0.6f * std::max(0.0f, std::min(1.0f, (depth - 400.0f) / 3200.0f));
+        const float diffuse = std::max(0.0f, normal.dot(light));
+        const uint8_t lit = static_cast<uint8_t>(lightColor * diffuse);
+        const uint8_t value = static_cast<uint8_t>(std::max(0, std::min(255, static_cast<int>(fade * (ambientColor + lit)))));
+        rgb[0] = rgb[1] = rgb[2] = value;
+    }
+}
+
+// Rotates a width x height image of `elemSize`-byte pixels by 90, 180 or
+// 270 degrees clockwise into `out`; any other angle copies it.
+inline void rotate_image(const uint8_t* in, int elemSize, int width, int height, int angle, uint8_t* out)
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int target;
+            switch (angle)
+            {
+            case 90: target = x * height + (height - 1 - y); break;
+            case 180: target = (height - 1 - y) * width + (width - 1 - x); break;
+            case 270: target = (width - 1 - x) * height + y; break;
+            default: target = y * width + x; break;
+            }
+            std::memcpy(out + target * elemSize, in + (y * width + x) * elemSize, elemSize);
+        }
+    }
+}
+
+#endif /* FRAMEKERNELS_HPP */
@@ -0,0 +1,40 @@
+#ifndef FRAMEVIEWS_HPP
+#define FRAMEVIEWS_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include <cstdint>
+
+// Non-owning views of one frame's data. Live frames point into the SDK's
+// buffers, replayed frames into the recording; either way the pointers are
+// only valid while that frame is being processed.
+
+struct DepthView
+{
+    const int16_t* data{ nullptr };
+    int width{ 0 };
+    int height{ 0 };
+    astra_frame_index_t frameIndex{ 0 };
+
+    bool is_valid() const { return data != nullptr && width > 0 && height > 0; }
+};
+
+struct BodyFrameView
+{
+    bool valid{ false };
+    astra_frame_index_t frameIndex{ 0 };
+    int width{ 0 };
+    int height{ 0 };
+
+    const astra_body_t* bodies{ nullptr }; // contiguous, `count` entries
+    int count{ 0 };
+
+    astra_plane_t floorPlane{ 0.f, 0.f, 0.f, 0.f };
+    bool floorDetected{ false };
+
+    const uint8_t* bodyMask{ nullptr };  // maskWidth * maskHeight, may be null
+    const uint8_t* floorMask{ nullptr };
+    int maskWidth{ 0 };
+    int maskHeight{ 0 };
+};
+
+#endif /* FRAMEVIEWS_HPP */
@@ -0,0 +1,205 @@
+#ifndef INGESTSERVER_HPP
+#define INGESTSERVER_HPP
+
+#include "OffloadServer.hpp"
+#include "WorkStealingPool.hpp"
+#include <sys/epoll.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+// Offload host for a whole facility: any number of dogs, each on its own
+// connection with its own OffloadSession, speaking the protocol in
+// Transport.hpp.
+//
+// One thread waits on epoll; connections are registered EPOLLONESHOT, so
+// a readable connection is handed to the pool as a single task and not
+// reported again until that task re-arms it. Each connection is thereby
+// a strand: its socket and analysis state are only ever touched by one
+// worker at a time, without locks, while different dogs run on all
+// cores. The task reads everything available, answers every frame,
+// writes what the socket takes and asks for EPOLLOUT if anything is left.
+class IngestServer
+{
+public:
+    struct Stats
+    {
+        size_t connections{ 0 };    // open now
+        size_t accepted{ 0 };
+        size_t frames{ 0 };
+        size_t malformed{ 0 };
+    };
+
+    explicit IngestServer(int workers = std::max(1u, std::thread::hardware_concurrency()))
+        : pool_(workers)
+    { }
+
+    ~IngestServer()
+    {
+        // Workers first: a service() still running uses the epoll fd and
+        // may delete its connection.
+        pool_.stop();
+        for (Connection* connection : open_) { delete connection; }
+        if (listenFd_ >= 0) { ::close(listenFd_); }
+        if (epollFd_ >= 0) { ::close(epollFd_); }
+    }
+
+    IngestServer(const IngestServer&) = delete;
+    IngestServer& operator=(const IngestServer&) = delete;
+
+    bool open(const char* host, int port)
+    {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        listenFd_ = tcp_listen(host, port);
+        if (epollFd_ < 0 || listenFd_ < 0) { return false; }
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        return epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &event) == 0;
+    }
+
+    // Loads the action model once; every session shares it.
+    bool load_model(const char* path)
+    {
+        return model_.load(path);
+    }
+
+    int worker_count() const { return pool_.size(); }
+
+    Stats stats() const
+    {
+        Stats stats;
+        stats.connections = connections_.load();
+        stats.accepted = accepted_.load();
+        stats.frames = frames_.load();
+        stats.malformed = malformed_.load();
+        return stats;
+    }
+
+    size_t steals() const { return pool_.steals(); }
+
+    // Runs the event loop on the calling thread until `stop` is set.
+    // Connections still open then are closed by the destructor.
+    void run(const std::atomic<bool>& stop)
+    {
+        epoll_event events[64];
+        while (!stop.load())
+        {
+            const int n = epoll_wait(epollFd_, events, 64, 100);
+            for (int i = 0; i < n; i++)
+            {
+                Connection* connection = static_cast<Connection*>(events[i].data.ptr);
+                if (connection == nullptr)
+                {
+                    accept_all();
+                    continue;
+                }
+                pool_.submit([this, connection] { service(connection); });
+            }
+        }
+    }
+
+private:
+    struct Connection
+    {
+        PacketChannel channel;
+        OffloadSession session;
+    };
+
+    void accept_all()
+    {
+        for (;;)
+        {
+            const int fd = ::accept(listenFd_, nullptr, nullptr);
+            if (fd < 0) { return; }
+            set_nonblocking(fd);
+            set_low_latency(fd);
+
+            Connection* connection = new Connection;
+            connection->channel.attach(fd);
+            if (model_.is_loaded())
+            {
+                connection->session.analyzer().attach_model(model_);
+            }
+            // The pool already spreads dogs over the cores.
+            connection->session.analyzer().set_model_parallel(false);
+
+            epoll_event event;
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.ptr = connection;
+            if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0)
+            {
+                delete connection;
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(openMutex_);
+                open_.insert(connection);
+            }
+            connections_++;
+            accepted_++;
+        }
+    }
+
+    // Runs on a pool worker; the connection is disarmed meanwhile.
+    void service(Connection* connection)
+    {
+        PacketChannel& channel = connection->channel;
+        channel.fill();
+
+        PacketHeader header;
+        const uint8_t* payload;
+        while (channel.next_packet(header, payload))
+        {
+            if (header.type != PACKET_FRAME) { continue; }
+            if (connection->session.handle_frame(header, payload, channel))
+            {
+                frames_++;
+            }
+            else
+            {
+                malformed_++;
+            }
+        }
+        channel.flush();
+
+        if (!channel.is_open())
+        {
+            // Closing the socket also takes it out of the epoll set.
+            {
+                std::lock_guard<std::mutex> lock(openMutex_);
+                open_.erase(connection);
+            }
+            delete connection;
+            connections_--;
+            return;
+        }
+
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        if (channel.pending_bytes() > 0) { event.events |= EPOLLOUT; }
+        event.data.ptr = connection;
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, channel.fd(), &event);
+    }
+
+    stgcn::Model model_;
+    int epollFd_{ -1 };
+    int listenFd_{ -1 };
+
+    // Every accepted connection not yet closed, for the destructor.
+    std::mutex openMutex_;
+    std::unordered_set<Connection*> open_;
+
+    std::atomic<size_t> connections_{ 0 };
+    std::atomic<size_t> accepted_{ 0 };
+    std::atomic<size_t> frames_{ 0 };
+    std::atomic<size_t> malformed_{ 0 };
+
+    // Stopped first thing in the destructor, so workers are joined
+    // before anything they use goes away.
+    WorkStealingPool pool_;
+};
+
+#endif /* INGESTSERVER_HPP */
@@ -0,0 +1,357 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "AllocCounter.hpp"
+#include "FrameClock.hpp"
+#include "Transport.hpp"
+#include <poll.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counters, gauges and latency histograms for the processing pipeline,
+// served in the Prometheus text format from a background thread.
+//
+// Updates are relaxed atomic adds and stores, so the hot path never takes
+// a lock or waits on a scrape; a scrape reads each value once and may see
+// a frame half-counted, which a monitoring system doesn't mind. Metrics
+// are registered once at startup, before the server starts.
+
+class MetricCounter
+{
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{ 0 };
+};
+
+class MetricGauge
+{
+public:
+    void set(double value) { value_.store(value, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{ 0.0 };
+};
+
+// Latency histogram with fixed buckets from 0.5 ms to 1 s.
+class MetricHistogram
+{
+public:
+    static const int kBuckets = 12;
+
+    void observe(FrameTime ns)
+    {
+        int b = 0;
+        while (b < kBuckets - 1 && ns > bound(b)) { b++; }
+        counts_[b].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(static_cast<uint64_t>(std::max<FrameTime>(ns, 0)), std::memory_order_relaxed);
+    }
+
+    // Upper bound of bucket b in ns; the last bucket is +Inf.
+    static FrameTime bound(int b)
+    {
+        static const FrameTime bounds[kBuckets - 1] = {
+            500000, 1000000, 2000000, 5000000, 10000000, 20000000,
+            50000000, 100000000, 250000000, 500000000, 1000000000,
+        };
+        return bounds[b];
+    }
+
+    uint64_t count(int b) const { return counts_[b].load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets] = {};
+    std::atomic<uint64_t> sum_{ 0 };
+};
+
+// Times a scope into a histogram.
+class MetricTimer
+{
+public:
+    explicit MetricTimer(MetricHistogram& histogram)
+        : histogram_(histogram),
+          begin_(frame_clock_now())
+    { }
+
+    ~MetricTimer()
+    {
+        histogram_.observe(frame_clock_now() - begin_);
+    }
+
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+private:
+    MetricHistogram& histogram_;
+    FrameTime begin_;
+};
+
+class MetricsRegistry
+{
+public:
+    // `labels` is either empty or e.g. `stage="depth"`. Metrics sharing a
+    // name must be registered one after another.
+    void add(const char* name, const char* help, const MetricCounter& counter, const char* labels = "")
+    {
+        entries_.push_back({ name, help, labels, COUNTER, &counter, nullptr, nullptr, nullptr });
+    }
+
+    void add(const char* name, const char* help, const MetricGauge& gauge, const char* labels = "")
+    {
+        entries_.push_back({ name, help, labels, GAUGE, nullptr, &gauge, nullptr, nullptr });
+    }
+
+    void add(const char* name, const char* help, const MetricHistogram& histogram, const char* labels = "")
+    {
+        entries_.push_back({ name, help, labels, HISTOGRAM, nullptr, nullptr, &histogram, nullptr });
+    }
+
+    // A gauge computed at scrape time, on the server thread.
+    void add(const char* name, const char* help, std::function<double()> sample, const char* labels = "")
+    {
+        entries_.push_back({ name, help, labels, GAUGE, nullptr, nullptr, nullptr, std::move(sample) });
+    }
+
+    void render(std::string& out) const
+    {
+        char line[256];
+        const char* previous = "";
+        for (const Entry& e : entries_)
+        {
+            if (strcmp(e.name, previous) != 0)
+            {
+                static const char* const types[] = { "counter", "gauge", "histogram" };
+                snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", e.name, e.help, e.name, types[e.type]);
+                out += line;
+                previous = e.name;
+            }
+
+            const bool labelled = e.labels[0] != '\0';
+            if (e.type == HISTOGRAM)
+            {
+                uint64_t cumulative = 0;
+                for (int b = 0; b < MetricHistogram::kBuckets; b++)
+                {
+                    cumulative += e.histogram->count(b);
+                    char le[32];
+                    if (b < MetricHistogram::kBuckets - 1)
+                    {
+                        snprintf(le, sizeof(le), "%g", MetricHistogram::bound(b) / 1e9);
+                    }
+                    else
+                    {
+                        snprintf(le, sizeof(le), "+Inf");
+                    }
+                    snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%s\"} %llu\n", e.name, e.labels,
+                             labelled ? "," : "", le, static_cast<unsigned long long>(cumulative));
+                    out += line;
+                }
+                snprintf(line, sizeof(line), "%s_sum%s%s%s %.9f\n%s_count%s%s%s %llu\n",
+                         e.name, labelled ? "{" : "", e.labels, labelled ? "}" : "", e.histogram->sum() / 1e9,
+                         e.name, labelled ? "{" : "", e.labels, labelled ? "}" : "",
+                         static_cast<unsigned long long>(cumulative));
+                out += line;
+                continue;
+            }
+
+            const double value = e.type == COUNTER ? static_cast<double>(e.counter->value())
+                               : e.gauge != nullptr ? e.gauge->value() : e.sample();
+            snprintf(line, sizeof(line), "%s%s%s%s %.17g\n", e.name,
+                     labelled ? "{" : "", e.labels, labelled ? "}" : "", value);
+            out += line;
+        }
+    }
+
+private:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry
+    {
+        const char* name;
+        const char* help;
+        const char* labels;
+        Type type;
+        const MetricCounter* counter;
+        const MetricGauge* gauge;
+        const MetricHistogram* histogram;
+        std::function<double()> sample;
+    };
+
+    std::vector<Entry> entries_;
+};
+
+// Resident set size of this process, from /proc/self/statm.
+inline double process_resident_bytes()
+{
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp == nullptr) { return 0.0; }
+    unsigned long pages = 0, resident = 0;
+    const int n = fscanf(fp, "%lu %lu", &pages, &resident);
+    fclose(fp);
+    return n == 2 ? static_cast<double>(resident) * sysconf(_SC_PAGESIZE) : 0.0;
+}
+
+// Minimal HTTP/1.0 server for GET /metrics, one request at a time.
+class MetricsServer
+{
+public:
+    explicit MetricsServer(const MetricsRegistry& registry)
+        : registry_(registry)
+    { }
+
+    ~MetricsServer()
+    {
+        stop();
+    }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool start(const char* host, int port)
+    {
+        listenFd_ = tcp_listen(host, port);
+        if (listenFd_ < 0) { return false; }
+        thread_ = std::thread([this] { serve(); });
+        printf("Metrics: serving http://%s:%d/metrics\n", host, port);
+        return true;
+    }
+
+    void stop()
+    {
+        stopping_ = true;
+        if (thread_.joinable()) { thread_.join(); }
+        if (listenFd_ >= 0)
+        {
+            ::close(listenFd_);
+            listenFd_ = -1;
+        }
+    }
+
+private:
+    void serve()
+    {
+        std::string body;
+        while (!stopping_.load())
+        {
+            pollfd p = { listenFd_, POLLIN, 0 };
+            if (::poll(&p, 1, 200) <= 0) { continue; }
+
+            const int fd = ::accept(listenFd_, nullptr, nullptr);
+            if (fd < 0) { continue; }
+
+            // A slow or idle client must not hold the thread.
+            timeval timeout = { 1, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            char request[1024];
+            size_t used = 0;
+            while (used < sizeof(request) - 1)
+            {
+                const ssize_t n = ::recv(fd, request + used, sizeof(request) - 1 - used, 0);
+                if (n <= 0) { break; }
+                used += static_cast<size_t>(n);
+                request[used] = '\0';
+                if (strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr) { break; }
+            }
+            request[used] = '\0';
+
+            body.clear();
+            const bool found = strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0;
+            if (found)
+            {
+                registry_.render(body);
+            }
+            else
+            {
+                body = "not found\n";
+            }
+
+            char header[160];
+            snprintf(header, sizeof(header),
+                     "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+                     found ? "200 OK" : "404 Not Found", body.size());
+            send_all(fd, header, strlen(header));
+            send_all(fd, body.data(), body.size());
+            ::close(fd);
+        }
+    }
+
+    static void send_all(int fd, const char* data, size_t bytes)
+    {
+        while (bytes > 0)
+        {
+            const ssize_t n = ::send(fd, data, bytes, MSG_NOSIGNAL);
+            if (n <= 0) { return; }
+            data += n;
+            bytes -= static_cast<size_t>(n);
+        }
+    }
+
+    const MetricsRegistry& registry_;
+    int listenFd_{ -1 };
+    std::atomic<bool> stopping_{ false };
+    std::thread thread_;
+};
+
+// What the dog exports.
+struct PipelineMetrics
+{
+    enum Stage { STAGE_DEPTH, STAGE_BODIES, STAGE_ANALYSIS, STAGE_RECORD, STAGE_OFFLOAD, STAGE_FRAME, STAGE_COUNT };
+
+    MetricCounter framesReceived;
+    MetricCounter framesDropped;    // gaps in the sensor's frame index
+    MetricHistogram stageLatency[STAGE_COUNT];
+    MetricGauge bodiesTracked;
+    MetricCounter alarmsRaised;
+    MetricCounter cmdVelPublished;
+    std::atomic<FrameTime> cmdVelLastPublish{ 0 };
+    MetricCounter heapAllocations;  // after warm-up; only counted with DOG_ALLOC_COUNT
+    MetricGauge arenaHighWater;
+
+    void register_with(MetricsRegistry& registry) const
+    {
+        static const char* const stageLabels[STAGE_COUNT] = {
+            "stage=\"depth\"", "stage=\"bodies\"", "stage=\"analysis\"",
+            "stage=\"record\"", "stage=\"offload\"", "stage=\"frame\"",
+        };
+
+        registry.add("dog_frames_received_total", "Frames delivered by the sensor or replay.", framesReceived);
+        registry.add("dog_frames_dropped_total", "Frames skipped by the sensor, from frame index gaps.", framesDropped);
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            registry.add("dog_stage_latency_seconds", "Time spent per frame in each pipeline stage.",
+                         stageLatency[s], stageLabels[s]);
+        }
+        registry.add("dog_bodies_tracked", "Bodies in the last processed frame.", bodiesTracked);
+        registry.add("dog_alarms_raised_total", "Accidents detected (rising edges).", alarmsRaised);
+        registry.add("dog_cmd_vel_published_total", "Twist messages published on /cmd_vel.", cmdVelPublished);
+        registry.add("dog_cmd_vel_staleness_seconds", "Time since the last /cmd_vel publish.", [this] {
+            const FrameTime last = cmdVelLastPublish.load(std::memory_order_relaxed);
+            return last == 0 ? -1.0 : frame_time_seconds(frame_clock_now() - last);
+        });
+        if (heap_counting_enabled())
+        {
+            registry.add("dog_frame_heap_allocations_total", "Heap allocations on the frame path after warm-up.",
+                         heapAllocations);
+        }
+        registry.add("dog_frame_arena_high_water_bytes", "Most per-frame scratch memory any frame has used.",
+                     arenaHighWater);
+        registry.add("dog_resident_memory_bytes", "Resident set size of the process.", [] {
+            return process_resident_bytes();
+        });
+    }
+};
+
+#endif /* METRICS_HPP */
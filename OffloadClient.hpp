@@ -0,0 +1,274 @@
+#ifndef OFFLOADCLIENT_HPP
+#define OFFLOADCLIENT_HPP
+
+#include "BodyAnalysis.hpp"
+#include "DepthCodec.hpp"
+#include "FrameClock.hpp"
+#include "FrameViews.hpp"
+#include "SkeletonPacket.hpp"
+#include "Transport.hpp"
+#include <poll.h>
+#include <algorithm>
+#include <string>
+
+// Dog side of the offload link: streams each processed frame to an
+// analysis host and keeps the latest decision it sent back.
+//
+// Frames are pipelined, up to `maxInFlight` unanswered at a time; beyond
+// that, or while the socket is backed up, new frames are dropped rather
+// than queued, so a slow link never adds latency. The link counts as
+// healthy while answers keep coming within `stallTimeout`; otherwise the
+// caller falls back to its own analysis. A link silent for a few seconds
+// is torn down and reconnected.
+class OffloadClient
+{
+public:
+    struct Stats
+    {
+        size_t sent{ 0 };
+        size_t dropped{ 0 };
+        size_t decisions{ 0 };
+        size_t reconnects{ 0 };
+        FrameTime rtt{ 0 };         // smoothed round trip
+        FrameTime rttMax{ 0 };
+        FrameTime serverTime{ 0 };  // smoothed host processing time
+    };
+
+    OffloadClient(const std::string& host, int port,
+                  int maxInFlight = 3,
+                  FrameTime stallTimeout = 250000000LL)
+        : host_(host),
+          port_(port),
+          maxInFlight_(std::min(std::max(maxInFlight, 1), static_cast<int>(kSendSlots))),
+          stallTimeout_(stallTimeout),
+          depthScratch_(depth_max_encoded_size(ASTRA_TEMP_IMAGE_LENGTH))
+    { }
+
+    // Sends RVL-coded depth with every frame so the host can run the
+    // depth-only tracker itself; otherwise only skeletons are sent.
+    void set_send_depth(bool sendDepth)
+    {
+        sendDepth_ = sendDepth;
+    }
+
+    // `arrival` is when the frame came in on the frame clock; the answer's
+    // FollowDecision::sourceTime is set from it.
+    void send_frame(FrameTime now, FrameTime frameTime, FrameTime arrival,
+                    const DepthView& depth, const BodyFrameView& body)
+    {
+        poll(now);
+        if (!ready())
+        {
+            stats_.dropped++;
+            return;
+        }
+
+        FramePayload frame;
+        std::memset(&frame, 0, sizeof(frame));
+        frame.frameTime = frameTime;
+        frame.frameIndex = static_cast<uint32_t>(body.valid ? body.frameIndex : depth.frameIndex);
+        frame.bodyCount = static_cast<uint8_t>(body.valid ? std::min(body.count, static_cast<int>(ASTRA_MAX_BODIES)) : 0);
+        frame.floorDetected = body.valid && body.floorDetected;
+        frame.floorPlane[0] = body.floorPlane.a;
+        frame.floorPlane[1] = body.floorPlane.b;
+        frame.floorPlane[2] = body.floorPlane.c;
+        frame.floorPlane[3] = body.floorPlane.d;
+
+        const size_t pixels = depth.is_valid() ? static_cast<size_t>(depth.width) * depth.height : 0;
+        const bool withDepth = sendDepth_ && pixels > 0 && pixels <= ASTRA_TEMP_IMAGE_LENGTH;
+        if (withDepth)
+        {
+            frame.width = static_cast<uint16_t>(depth.width);
+            frame.height = static_cast<uint16_t>(depth.height);
+            frame.depthBytes = static_cast<uint32_t>(depth_encode(depth.data, pixels, depthScratch_.data()));
+        }
+
+        // Skeletons are delta-coded against the last frame sent, so only
+        // encode once the frame is sure to go out.
+        const uint32_t sequence = sequence_ + 1;
+        if (!channel_.begin_packet(PACKET_FRAME, sequence, now, sizeof(frame) + kSkeletonPacketMaxBytes + frame.depthBytes))
+        {
+            stats_.dropped++;
+            return;
+        }
+        frame.skeletonBytes = static_cast<uint16_t>(skeletons_.encode(body.bodies, frame.bodyCount, skeletonScratch_));
+        channel_.append(&frame, sizeof(frame));
+        channel_.append(skeletonScratch_, frame.skeletonBytes);
+        channel_.append(depthScratch_.data(), frame.depthBytes);
+        channel_.end_packet();
+
+        sequence_ = sequence;
+        sentTimes_[sequence % kSendSlots] = now;
+        arrivalTimes_[sequence % kSendSlots] = arrival;
+        stats_.sent++;
+        channel_.flush();
+    }
+
+    // Completes the connection, writes pending data and reads decisions.
+    // Never blocks.
+    void poll(FrameTime now)
+    {
+        if (!channel_.is_open())
+        {
+            reconnect(now);
+            return;
+        }
+        if (!connected_ && !finish_connect())
+        {
+            return;
+        }
+
+        channel_.flush();
+        channel_.fill();
+        PacketHeader header;
+        const uint8_t* payload;
+        while (channel_.next_packet(header, payload))
+        {
+            if (header.type == PACKET_DECISION && header.payloadBytes >= sizeof(DecisionPayload))
+            {
+                DecisionPayload decision;
+                std::memcpy(&decision, payload, sizeof(decision));
+                accept(decision, now);
+            }
+        }
+        if (!channel_.is_open())
+        {
+            disconnect(now);
+            return;
+        }
+
+        // The host has gone quiet with frames outstanding; start over.
+        if (in_flight() > 0 && now - sentTimes_[(acked_ + 1) % kSendSlots] > kReconnectAfter)
+        {
+            printf("Offload: no answer from %s:%d, reconnecting\n", host_.c_str(), port_);
+            disconnect(now);
+        }
+    }
+
+    // True while the latest decision is recent and nothing sent has been
+    // waiting longer than the stall timeout.
+    bool healthy(FrameTime now) const
+    {
+        if (!connected_ || stats_.decisions == 0 || now - decisionTime_ > stallTimeout_)
+        {
+            return false;
+        }
+        return in_flight() == 0 || now - sentTimes_[(acked_ + 1) % kSendSlots] <= stallTimeout_;
+    }
+
+    // Whether send_frame() would send rather than drop right now.
+    bool ready() const
+    {
+        return connected_ && in_flight() < static_cast<uint32_t>(maxInFlight_);
+    }
+
+    const FollowDecision& decision() const { return decision_; }
+    const Stats& stats() const { return stats_; }
+
+    void print_report() const
+    {
+        printf("Offload: %zu sent, %zu dropped, %zu decisions, %zu reconnects\n",
+               stats_.sent, stats_.dropped, stats_.decisions, stats_.reconnects);
+        printf("Offload: rtt %.1f ms (max %.1f ms), host %.1f ms\n",
+               stats_.rtt / 1e6, stats_.rttMax / 1e6, stats_.serverTime / 1e6);
+    }
+
+private:
+    static const int kSendSlots = 8;
+    static const FrameTime kReconnectAfter = 2000000000LL;
+    static const FrameTime kRetryInterval = 1000000000LL;
+
+    uint32_t in_flight() const { return sequence_ - acked_; }
+
+    void reconnect(FrameTime now)
+    {
+        if (now - lastAttempt_ < kRetryInterval) { return; }
+        lastAttempt_ = now;
+
+        const int fd = tcp_connect(host_.c_str(), port_);
+        if (fd >= 0)
+        {
+            channel_.attach(fd);
+        }
+    }
+
+    bool finish_connect()
+    {
+        pollfd p = { channel_.fd(), POLLOUT, 0 };
+        if (::poll(&p, 1, 0) <= 0) { return false; }
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0)
+        {
+            channel_.close();
+            return false;
+        }
+
+        connected_ = true;
+        acked_ = sequence_;
+        skeletons_.reset();
+        stats_.reconnects += everConnected_ ? 1 : 0;
+        everConnected_ = true;
+        printf("Offload: connected to %s:%d\n", host_.c_str(), port_);
+        return true;
+    }
+
+    void disconnect(FrameTime now)
+    {
+        channel_.close();
+        connected_ = false;
+        acked_ = sequence_;
+        lastAttempt_ = now;
+    }
+
+    void accept(const DecisionPayload& answer, FrameTime now)
+    {
+        // Stale, duplicate or unknown answers don't move anything.
+        const uint32_t ahead = answer.frameSequence - acked_;
+        if (ahead == 0 || ahead > in_flight()) { return; }
+        acked_ = answer.frameSequence;
+
+        decision_ = FollowDecision();
+        decision_.target = answer.targetId != 0 ? 0 : -1;
+        decision_.targetId = answer.targetId;
+        decision_.alarm = answer.alarm != 0;
+        decision_.distance = answer.distance;
+        decision_.lateral = answer.lateral;
+        decision_.sourceTime = arrivalTimes_[answer.frameSequence % kSendSlots];
+        decisionTime_ = now;
+
+        const FrameTime rtt = now - answer.echoTime;
+        stats_.rtt = stats_.decisions == 0 ? rtt : stats_.rtt + (rtt - stats_.rtt) / 8;
+        stats_.rttMax = std::max(stats_.rttMax, rtt);
+        stats_.serverTime = stats_.decisions == 0 ? answer.serverTime
+                                                  : stats_.serverTime + (answer.serverTime - stats_.serverTime) / 8;
+        stats_.decisions++;
+    }
+
+    std::string host_;
+    int port_;
+    int maxInFlight_;
+    FrameTime stallTimeout_;
+    bool sendDepth_{ false };
+
+    PacketChannel channel_;
+    bool connected_{ false };
+    bool everConnected_{ false };
+    FrameTime lastAttempt_{ -kRetryInterval };
+
+    uint32_t sequence_{ 0 };
+    uint32_t acked_{ 0 };
+    FrameTime sentTimes_[kSendSlots] = { 0 };
+    FrameTime arrivalTimes_[kSendSlots] = { 0 };
+    std::vector<uint8_t> depthScratch_;
+    SkeletonEncoder skeletons_;
+    uint8_t skeletonScratch_[kSkeletonPacketMaxBytes];
+
+    FollowDecision decision_;
+    FrameTime decisionTime_{ 0 };
+    Stats stats_;
+};
+
+#endif /* OFFLOADCLIENT_HPP */
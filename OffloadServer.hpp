@@ -0,0 +1,202 @@
+#ifndef OFFLOADSERVER_HPP
+#define OFFLOADSERVER_HPP
+
+#include "BodyAnalysis.hpp"
+#include "DepthCodec.hpp"
+#include "DepthFallbackTracker.hpp"
+#include "FrameClock.hpp"
+#include "SkeletonPacket.hpp"
+#include "Trace.hpp"
+#include "Transport.hpp"
+#include <poll.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Analysis state for one dog: skeleton decoding, the depth-only tracker
+// and the body analysis, answering each FRAME packet with a DECISION.
+//
+// Frames are analysed with the dog's frame timestamps, so the temporal
+// filters behave as they would on board. A frame with depth but no bodies
+// goes through the depth-only tracker first.
+class OffloadSession
+{
+public:
+    OffloadSession()
+        : depth_(ASTRA_TEMP_IMAGE_LENGTH)
+    { }
+
+    OffloadSession(const OffloadSession&) = delete;
+    OffloadSession& operator=(const OffloadSession&) = delete;
+
+    BodyAnalyzer& analyzer() { return analyzer_; }
+
+    // A new connection from the same dog; the analysis state carries
+    // over, as it would across a dropped frame on board.
+    void reconnected()
+    {
+        skeletons_.reset();
+    }
+
+    // False if the frame was malformed; nothing is sent then.
+    bool handle_frame(const PacketHeader& header, const uint8_t* payload, PacketChannel& out)
+    {
+        TRACE_ZONE("OffloadSession::handle_frame");
+        const FrameTime begin = frame_clock_now();
+
+        arenas_.reset();
+        FramePayload frame;
+        if (header.payloadBytes < sizeof(frame)) { return false; }
+        std::memcpy(&frame, payload, sizeof(frame));
+
+        const size_t pixels = static_cast<size_t>(frame.width) * frame.height;
+        if (pixels > depth_.size() ||
+            sizeof(frame) + frame.skeletonBytes + frame.depthBytes > header.payloadBytes ||
+            !skeletons_.decode(payload + sizeof(frame), frame.skeletonBytes, bodies_))
+        {
+            return false;
+        }
+
+        int count = bodies_.count;
+        if (count == 0 && frame.depthBytes > 0 &&
+            depth_decode(payload + sizeof(frame) + frame.skeletonBytes, frame.depthBytes, depth_.data(), pixels))
+        {
+            count = fallbackTracker_.process(depth_.data(), frame.width, frame.height, bodies_, arenas_.frame());
+        }
+        for (int i = 0; i < count; i++)
+        {
+            bodyPtrs_[i] = &bodies_.bodies[i];
+        }
+
+        const astra_plane_t floorPlane = { frame.floorPlane[0], frame.floorPlane[1],
+                                           frame.floorPlane[2], frame.floorPlane[3] };
+        analyzer_.analyze(frame.frameTime, bodyPtrs_, count, floorPlane, frame.floorDetected != 0, arenas_);
+        const FollowDecision decision = analyzer_.decide();
+
+        DecisionPayload answer;
+        std::memset(&answer, 0, sizeof(answer));
+        answer.frameSequence = header.sequence;
+        answer.targetId = decision.target >= 0 ? decision.targetId : 0;
+        answer.echoTime = header.sentTime;
+        answer.distance = decision.distance;
+        answer.lateral = decision.lateral;
+        answer.alarm = decision.alarm;
+        answer.bodyCount = static_cast<uint8_t>(count);
+        answer.serverTime = frame_clock_now() - begin;
+
+        if (out.begin_packet(PACKET_DECISION, ++sequence_, frame_clock_now(), sizeof(answer)))
+        {
+            out.append(&answer, sizeof(answer));
+            out.end_packet();
+        }
+        return true;
+    }
+
+private:
+    uint32_t sequence_{ 0 };
+    BodyAnalyzer analyzer_;
+    SkeletonDecoder skeletons_;
+    DepthFallbackTracker fallbackTracker_;
+    std::vector<int16_t> depth_;
+    FrameArenas arenas_;
+    astra_body_list_t bodies_;
+    const astra_body_t* bodyPtrs_[ASTRA_MAX_BODIES];
+};
+
+// Host side of the offload link for a single dog. A new connection
+// replaces the current one.
+class OffloadServer
+{
+public:
+    OffloadServer() = default;
+
+    ~OffloadServer()
+    {
+        close();
+    }
+
+    OffloadServer(const OffloadServer&) = delete;
+    OffloadServer& operator=(const OffloadServer&) = delete;
+
+    bool open(const char* host, int port)
+    {
+        close();
+        listenFd_ = tcp_listen(host, port);
+        return listenFd_ >= 0;
+    }
+
+    void close()
+    {
+        client_.close();
+        if (listenFd_ >= 0)
+        {
+            ::close(listenFd_);
+            listenFd_ = -1;
+        }
+    }
+
+    bool load_model(const char* path)
+    {
+        return session_.analyzer().load_model(path);
+    }
+
+    // Serves until `stop` is set; checks it at least every 100 ms.
+    void run(const std::atomic<bool>& stop)
+    {
+        TRACE_THREAD("offload host");
+        while (!stop.load() && listenFd_ >= 0)
+        {
+            serve(100);
+        }
+    }
+
+    // Waits up to `timeoutMs` for traffic and handles it.
+    void serve(int timeoutMs)
+    {
+        pollfd fds[2] = { { listenFd_, POLLIN, 0 }, { client_.fd(), POLLIN, 0 } };
+        if (::poll(fds, client_.is_open() ? 2 : 1, timeoutMs) <= 0) { return; }
+
+        if (fds[0].revents & POLLIN)
+        {
+            const int fd = ::accept(listenFd_, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                set_nonblocking(fd);
+                set_low_latency(fd);
+                client_.attach(fd);
+                session_.reconnected();
+                printf("Offload server: dog connected\n");
+            }
+        }
+
+        if (client_.is_open())
+        {
+            client_.fill();
+            PacketHeader header;
+            const uint8_t* payload;
+            while (client_.next_packet(header, payload))
+            {
+                if (header.type != PACKET_FRAME) { continue; }
+                if (session_.handle_frame(header, payload, client_))
+                {
+                    framesServed_++;
+                }
+                else
+                {
+                    printf("Offload server: malformed frame %u\n", header.sequence);
+                }
+            }
+            client_.flush();
+        }
+    }
+
+    size_t frames_served() const { return framesServed_; }
+
+private:
+    int listenFd_{ -1 };
+    PacketChannel client_;
+    OffloadSession session_;
+    size_t framesServed_{ 0 };
+};
+
+#endif /* OFFLOADSERVER_HPP */
@@ -0,0 +1,111 @@
+#ifndef PARALLELBANDS_HPP
+#define PARALLELBANDS_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent workers that split an image into horizontal row bands.
+// run() blocks until every band is done; the calling thread takes the
+// first band itself, so a pool of N threads uses N + 1 cores.
+class ParallelBands
+{
+public:
+    using BandFunction = std::function<void(int rowBegin, int rowEnd, int band)>;
+
+    explicit ParallelBands(int threads = std::max(1u, std::thread::hardware_concurrency()) - 1)
+    {
+        for (int i = 0; i < threads; i++)
+        {
+            workers_.emplace_back([this, i] { worker_loop(i + 1); });
+        }
+    }
+
+    ~ParallelBands()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) { worker.join(); }
+    }
+
+    ParallelBands(const ParallelBands&) = delete;
+    ParallelBands& operator=(const ParallelBands&) = delete;
+
+    int band_count() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Rows are split only when every band gets at least minRowsPerBand
+    // of them; otherwise the calling thread does all the work.
+    void run(int rows, const BandFunction& fn, int minRowsPerBand = 4)
+    {
+        const int bands = band_count();
+        if (bands == 1 || rows < bands * minRowsPerBand)
+        {
+            fn(0, rows, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &fn;
+            rows_ = rows;
+            pending_ = bands - 1;
+            generation_++;
+        }
+        wake_.notify_all();
+
+        run_band(fn, 0, rows, bands);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    static void run_band(const BandFunction& fn, int band, int rows, int bands)
+    {
+        const int begin = rows * band / bands;
+        const int end = rows * (band + 1) / bands;
+        fn(begin, end, band);
+    }
+
+    void worker_loop(int band)
+    {
+        unsigned seen = 0;
+        for (;;)
+        {
+            const BandFunction* job;
+            int rows;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) { return; }
+                seen = generation_;
+                job = job_;
+                rows = rows_;
+            }
+
+            run_band(*job, band, rows, band_count());
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) { done_.notify_one(); }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const BandFunction* job_{ nullptr };
+    int rows_{ 0 };
+    int pending_{ 0 };
+    unsigned generation_{ 0 };
+    bool stopping_{ false };
+};
+
+#endif /* PARALLELBANDS_HPP */
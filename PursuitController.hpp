@@ -0,0 +1,182 @@
+#ifndef PURSUITCONTROLLER_HPP
+#define PURSUITCONTROLLER_HPP
+
+#include "BodyAnalysis.hpp"
+#include "FrameClock.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Gains and limits of the follow controller, from [follow] in dog.toml;
+// the top speeds and the follow distance are in AnalysisThresholds.
+struct PursuitSettings
+{
+    float distanceGain{ 0.8f };              // m/s per m beyond the follow distance
+    float bearingGain{ 1.5f };               // rad/s per rad off-centre
+    float linearAccel{ 0.5f };               // m/s^2
+    float angularAccel{ 1.5f };              // rad/s^2
+    FrameTime actuationDelay{ 50000000LL };  // from publishing to the motors moving
+};
+
+// Turns where the target was seen into a smooth twist, stepped once per
+// /cmd_vel publish.
+//
+// By the time a frame's twist moves the dog the target has moved on: the
+// frame was analysed, waited for the next tick and still has to go through
+// ROS to the motors. The controller follows the target's position on the
+// floor, relative to the dog, with an alpha-beta filter over the frames,
+// and aims at where it will be when the twist takes effect: the frame's
+// age at the tick, as measured from its sourceTime, plus
+// `actuationDelay`, at most kMaxHorizon ahead.
+//
+// Distance is held by a P law with the target's own forward speed fed
+// forward, the bearing by a P law with its own bearing rate fed forward;
+// "own" meaning with the dog's last command taken back out of the relative
+// motion. Both outputs are clamped to the follow speeds and slewed by the
+// acceleration limits, so the dog eases in and out of motion instead of
+// switching between full speed and stop.
+//
+// Not thread-safe; CmdVelWatchdog steps it from its thread.
+class PursuitController
+{
+public:
+    void configure(const AnalysisThresholds& thresholds, const PursuitSettings& settings)
+    {
+        thresholds_ = thresholds;
+        settings_ = settings;
+    }
+
+    // The twist for `now`, given the latest decision. `speedScale` in
+    // [0, 1] caps both speeds below the follow speeds; the watchdog uses it
+    // to bring the dog down when frames stop coming.
+    void step(FrameTime now, const FollowDecision& decision, float speedScale, float& linear, float& angular)
+    {
+        observe(decision);
+
+        float wantLinear = 0.f;
+        float wantAngular = 0.f;
+        if (tracking_)
+        {
+            const FrameTime lead = now - observedAt_ + settings_.actuationDelay;
+            lead_.set(frame_time_seconds(lead));
+            const FrameTime maxHorizon = kMaxHorizon;  // std::min would odr-use the member
+            const float horizon = static_cast<float>(frame_time_seconds(std::min(lead, maxHorizon)));
+            const float f = std::max(forward_.position + forward_.velocity * horizon, 0.1f);
+            const float l = lateral_.position + lateral_.velocity * horizon;
+
+            // The dog's own motion shows up in the relative velocity; take
+            // it back out to get what the target itself is doing. Positive
+            // angular turns towards positive lateral.
+            const float targetForward = forward_.velocity + linear_;
+            const float bearingRate = (f * lateral_.velocity - l * forward_.velocity) / (f * f + l * l) + angular_;
+
+            const float distance = std::sqrt(f * f + l * l);
+            wantLinear = settings_.distanceGain * (distance - thresholds_.followDistance) + targetForward;
+
+            const float deadband = thresholds_.followDeadband / 1000.f;
+            const float offCentre = std::max(std::fabs(l) - deadband, 0.f);
+            const float bearing = std::atan2(l < 0.f ? -offCentre : offCentre, f);
+            wantAngular = settings_.bearingGain * bearing + (offCentre > 0.f ? bearingRate : 0.f);
+        }
+        wantLinear = clamp(wantLinear, 0.f, thresholds_.followLinear);
+        wantAngular = clamp(wantAngular, -thresholds_.followAngular, thresholds_.followAngular);
+
+        const FrameTime maxStep = kMaxStep;
+        const float dt = lastStep_ > 0 ? static_cast<float>(frame_time_seconds(std::min(now - lastStep_, maxStep))) : 0.f;
+        lastStep_ = now;
+        linear_ += clamp(wantLinear - linear_, -settings_.linearAccel * dt, settings_.linearAccel * dt);
+        angular_ += clamp(wantAngular - angular_, -settings_.angularAccel * dt, settings_.angularAccel * dt);
+
+        // The cap is a safety stop, so it is not slewed.
+        const float scale = clamp(speedScale, 0.f, 1.f);
+        linear_ = clamp(linear_, -thresholds_.followLinear * scale, thresholds_.followLinear * scale);
+        angular_ = clamp(angular_, -thresholds_.followAngular * scale, thresholds_.followAngular * scale);
+
+        linear = linear_;
+        angular = angular_;
+    }
+
+    void register_with(MetricsRegistry& registry) const
+    {
+        registry.add("dog_follow_lead_seconds", "How far ahead of the last frame the controller aims.", lead_);
+    }
+
+private:
+    static const FrameTime kMaxHorizon = 500000000LL;
+    static const FrameTime kMaxStep = 100000000LL;
+    static const FrameTime kTrackGap = 1000000000LL;  // longer without the target starts afresh
+
+    // Position and velocity along one axis, in m and m/s.
+    struct AlphaBeta
+    {
+        float position{ 0.f };
+        float velocity{ 0.f };
+
+        void reset(float z)
+        {
+            position = z;
+            velocity = 0.f;
+        }
+
+        void update(float z, float dt)
+        {
+            const float alpha = 0.6f;
+            const float beta = 0.25f;
+            position += velocity * dt;
+            const float residual = z - position;
+            position += alpha * residual;
+            velocity += beta * residual / dt;
+        }
+    };
+
+    static float clamp(float value, float low, float high)
+    {
+        return std::max(low, std::min(value, high));
+    }
+
+    void observe(const FollowDecision& decision)
+    {
+        if (decision.sourceTime <= observedAt_) { return; }
+        if (decision.target < 0)
+        {
+            tracking_ = false;
+            observedAt_ = decision.sourceTime;
+            return;
+        }
+
+        const float l = decision.lateral / 1000.f;
+        const float f = std::sqrt(std::max(decision.distance * decision.distance - l * l, 0.f));
+        const FrameTime gap = decision.sourceTime - observedAt_;
+        if (!tracking_ || decision.targetId != targetId_ || gap > kTrackGap)
+        {
+            forward_.reset(f);
+            lateral_.reset(l);
+        }
+        else
+        {
+            const float dt = static_cast<float>(frame_time_seconds(gap));
+            forward_.update(f, dt);
+            lateral_.update(l, dt);
+        }
+        tracking_ = true;
+        targetId_ = decision.targetId;
+        observedAt_ = decision.sourceTime;
+    }
+
+    AnalysisThresholds thresholds_;
+    PursuitSettings settings_;
+
+    bool tracking_{ false };
+    astra_body_id_t targetId_{ 0 };
+    FrameTime observedAt_{ 0 };
+    AlphaBeta forward_;
+    AlphaBeta lateral_;
+
+    FrameTime lastStep_{ 0 };
+    float linear_{ 0.f };
+    float angular_{ 0.f };
+
+    MetricGauge lead_;
+};
+
+#endif /* PURSUITCONTROLLER_HPP */
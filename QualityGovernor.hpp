@@ -0,0 +1,305 @@
+#ifndef QUALITYGOVERNOR_HPP
+#define QUALITYGOVERNOR_HPP
+
+#include "FrameClock.hpp"
+#include "Metrics.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Steps the pipeline down to cheaper settings when the perception host
+// runs hot or falls behind, and back up once it has recovered.
+//
+// Once a second evaluate() looks at the mean per-stage latency since the
+// last look (from the PipelineMetrics histograms), the CPU load from
+// /proc/stat and the hottest thermal zone under /sys/class/thermal. Any
+// of frame latency over budget, temperature over `hotCelsius` or CPU over
+// `busyLoad` moves one level down, at most once per `downHold`. Moving up
+// needs everything well clear (latency under 60% of the budget, 10 C
+// below hot, CPU under 80%) for `upHold`, so the level doesn't flap. The
+// caller applies the new level's settings; see QualityLevel.
+struct QualityLevel
+{
+    const char* name;
+    int depthDivisor;          // of the configured depth resolution
+    int skeletonOptimization;  // SDK body tracker, 1 (cheap) to 9 (accurate)
+    bool rendering;            // viewer textures and window drawing
+    int modelInterval;         // ST-GCN on every Nth frame
+};
+
+inline const QualityLevel* quality_levels(int& count)
+{
+    static const QualityLevel levels[] = {
+        { "full",       1, 9, true,  1 },
+        { "tracker",    1, 5, true,  1 },
+        { "headless",   1, 5, false, 1 },
+        { "model-1/2",  1, 5, false, 2 },
+        { "half-depth", 2, 5, false, 2 },
+        { "minimal",    2, 2, false, 4 },
+    };
+    count = static_cast<int>(sizeof(levels) / sizeof(levels[0]));
+    return levels;
+}
+
+class QualityGovernor
+{
+public:
+    explicit QualityGovernor(FrameTime latencyBudget = 50000000LL,
+                             float hotCelsius = 80.f,
+                             float busyLoad = 0.95f,
+                             FrameTime downHold = 2000000000LL,
+                             FrameTime upHold = 10000000000LL)
+        : budget_(latencyBudget),
+          hotCelsius_(hotCelsius),
+          busyLoad_(busyLoad),
+          downHold_(downHold),
+          upHold_(upHold)
+    {
+        levels_ = quality_levels(levelCount_);
+        worstLevel_ = levelCount_ - 1;
+        open_thermal_zones();
+        statFd_ = open("/proc/stat", O_RDONLY);
+        read_cpu_times(lastBusy_, lastTotal_);
+    }
+
+    ~QualityGovernor()
+    {
+        for (int i = 0; i < zoneCount_; i++) { close(zoneFds_[i]); }
+        if (statFd_ >= 0) { close(statFd_); }
+    }
+
+    QualityGovernor(const QualityGovernor&) = delete;
+    QualityGovernor& operator=(const QualityGovernor&) = delete;
+
+    void set_latency_budget(FrameTime budget)
+    {
+        budget_ = budget;
+    }
+
+    // Keeps the level within [best, worst]; equal values pin it.
+    void set_level_range(int best, int worst)
+    {
+        bestLevel_ = std::max(0, std::min(best, levelCount_ - 1));
+        worstLevel_ = std::max(bestLevel_, std::min(worst, levelCount_ - 1));
+        level_ = std::max(bestLevel_, std::min(level_, worstLevel_));
+        levelGauge_.set(level_);
+    }
+
+    // Call every main loop iteration; returns true when the level changed
+    // and its settings should be applied.
+    bool evaluate(FrameTime now, const PipelineMetrics& metrics)
+    {
+        if (lastEvaluation_ == 0)
+        {
+            lastEvaluation_ = now;
+            calmSince_ = now;
+            snapshot(metrics);
+            return false;
+        }
+        if (now - lastEvaluation_ < kInterval) { return false; }
+        lastEvaluation_ = now;
+
+        // Mean latency of every stage over the frames since the last look.
+        FrameTime stageMean[PipelineMetrics::STAGE_COUNT] = {};
+        uint64_t frames = 0;
+        for (int s = 0; s < PipelineMetrics::STAGE_COUNT; s++)
+        {
+            const MetricHistogram& h = metrics.stageLatency[s];
+            uint64_t count = 0;
+            for (int b = 0; b < MetricHistogram::kBuckets; b++) { count += h.count(b); }
+            const uint64_t n = count - lastCount_[s];
+            stageMean[s] = n > 0 ? static_cast<FrameTime>((h.sum() - lastSum_[s]) / n) : 0;
+            if (s == PipelineMetrics::STAGE_FRAME) { frames = n; }
+        }
+        snapshot(metrics);
+
+        latency_ = stageMean[PipelineMetrics::STAGE_FRAME];
+        celsius_ = read_celsius();
+        load_ = read_load();
+        latencyGauge_.set(frame_time_seconds(latency_));
+        celsiusGauge_.set(celsius_);
+        loadGauge_.set(load_);
+
+        const bool slow = frames > 0 && latency_ > budget_;
+        const bool hot = celsius_ > hotCelsius_;
+        const bool busy = load_ > busyLoad_;
+        if (slow || hot || busy)
+        {
+            calmSince_ = now;
+            if (level_ < worstLevel_ && now - lastChange_ >= downHold_)
+            {
+                change_level(now, level_ + 1, slow ? "latency" : hot ? "temperature" : "cpu", stageMean);
+                return true;
+            }
+            return false;
+        }
+
+        const bool calm = latency_ < budget_ * 6 / 10 && celsius_ < hotCelsius_ - 10.f && load_ < 0.8f;
+        if (!calm)
+        {
+            calmSince_ = now;
+            return false;
+        }
+        if (level_ > bestLevel_ && now - calmSince_ >= upHold_ && now - lastChange_ >= upHold_)
+        {
+            calmSince_ = now;
+            change_level(now, level_ - 1, "headroom", stageMean);
+            return true;
+        }
+        return false;
+    }
+
+    int level_index() const { return level_; }
+    const QualityLevel& level() const { return levels_[level_]; }
+
+    void register_with(MetricsRegistry& registry) const
+    {
+        registry.add("dog_quality_level", "Current quality level, 0 is full quality.", levelGauge_);
+        registry.add("dog_quality_changes_total", "Quality level changes made by the governor.", changes_);
+        registry.add("dog_quality_frame_latency_seconds", "Mean frame latency the governor last saw.", latencyGauge_);
+        registry.add("dog_thermal_celsius", "Hottest thermal zone.", celsiusGauge_);
+        registry.add("dog_cpu_load", "Busy fraction of all CPUs over the last second.", loadGauge_);
+    }
+
+private:
+    static const FrameTime kInterval = 1000000000LL;
+    static const int kMaxZones = 16;
+
+    void change_level(FrameTime now, int level, const char* reason, const FrameTime* stageMean)
+    {
+        static const char* const stageNames[PipelineMetrics::STAGE_COUNT] = {
+            "depth", "bodies", "analysis", "record", "offload", "frame",
+        };
+        int slowest = 0;
+        for (int s = 1; s < PipelineMetrics::STAGE_FRAME; s++)
+        {
+            if (stageMean[s] > stageMean[slowest]) { slowest = s; }
+        }
+
+        printf("Quality: %s -> %s (%s; frame %.1f ms of %.1f ms, slowest stage %s %.1f ms, %.1f C, cpu %.0f%%)\n",
+               levels_[level_].name, levels_[level].name, reason,
+               latency_ / 1e6, budget_ / 1e6, stageNames[slowest], stageMean[slowest] / 1e6,
+               celsius_, load_ * 100.f);
+        level_ = level;
+        lastChange_ = now;
+        levelGauge_.set(level);
+        changes_.add();
+    }
+
+    void snapshot(const PipelineMetrics& metrics)
+    {
+        for (int s = 0; s < PipelineMetrics::STAGE_COUNT; s++)
+        {
+            const MetricHistogram& h = metrics.stageLatency[s];
+            lastCount_[s] = 0;
+            for (int b = 0; b < MetricHistogram::kBuckets; b++) { lastCount_[s] += h.count(b); }
+            lastSum_[s] = h.sum();
+        }
+    }
+
+    void open_thermal_zones()
+    {
+        DIR* dir = opendir("/sys/class/thermal");
+        if (dir == nullptr) { return; }
+        while (dirent* entry = readdir(dir))
+        {
+            if (zoneCount_ == kMaxZones) { break; }
+            if (strncmp(entry->d_name, "thermal_zone", 12) != 0) { continue; }
+            char path[300];
+            snprintf(path, sizeof(path), "/sys/class/thermal/%s/temp", entry->d_name);
+            const int fd = open(path, O_RDONLY);
+            if (fd >= 0) { zoneFds_[zoneCount_++] = fd; }
+        }
+        closedir(dir);
+    }
+
+    // sysfs and procfs files are re-read from offset 0 with the fds kept
+    // open, so a look costs a few syscalls and no allocation.
+    static int read_file(int fd, char* buffer, size_t size)
+    {
+        const ssize_t n = pread(fd, buffer, size - 1, 0);
+        if (n <= 0) { return 0; }
+        buffer[n] = '\0';
+        return static_cast<int>(n);
+    }
+
+    float read_celsius() const
+    {
+        float hottest = 0.f;
+        char buffer[32];
+        for (int i = 0; i < zoneCount_; i++)
+        {
+            if (read_file(zoneFds_[i], buffer, sizeof(buffer)) > 0)
+            {
+                hottest = std::max(hottest, strtol(buffer, nullptr, 10) / 1000.f);
+            }
+        }
+        return hottest;
+    }
+
+    bool read_cpu_times(unsigned long long& busy, unsigned long long& total) const
+    {
+        char buffer[256];
+        if (statFd_ < 0 || read_file(statFd_, buffer, sizeof(buffer)) == 0) { return false; }
+        unsigned long long t[8] = {};
+        if (sscanf(buffer, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &t[0], &t[1], &t[2], &t[3], &t[4], &t[5], &t[6], &t[7]) < 4)
+        {
+            return false;
+        }
+        total = 0;
+        for (unsigned long long v : t) { total += v; }
+        busy = total - t[3] - t[4];  // minus idle and iowait
+        return true;
+    }
+
+    float read_load()
+    {
+        unsigned long long busy = 0, total = 0;
+        if (!read_cpu_times(busy, total) || total <= lastTotal_) { return 0.f; }
+        const float load = static_cast<float>(busy - lastBusy_) / (total - lastTotal_);
+        lastBusy_ = busy;
+        lastTotal_ = total;
+        return load;
+    }
+
+    const QualityLevel* levels_{ nullptr };
+    int levelCount_{ 0 };
+    int level_{ 0 };
+    int bestLevel_{ 0 };
+    int worstLevel_{ 0 };
+
+    FrameTime budget_;
+    float hotCelsius_;
+    float busyLoad_;
+    FrameTime downHold_;
+    FrameTime upHold_;
+
+    FrameTime lastEvaluation_{ 0 };
+    FrameTime lastChange_{ 0 };
+    FrameTime calmSince_{ 0 };
+    uint64_t lastCount_[PipelineMetrics::STAGE_COUNT] = {};
+    uint64_t lastSum_[PipelineMetrics::STAGE_COUNT] = {};
+
+    FrameTime latency_{ 0 };
+    float celsius_{ 0.f };
+    float load_{ 0.f };
+
+    int zoneFds_[kMaxZones];
+    int zoneCount_{ 0 };
+    int statFd_{ -1 };
+    unsigned long long lastBusy_{ 0 };
+    unsigned long long lastTotal_{ 0 };
+
+    MetricGauge levelGauge_;
+    MetricCounter changes_;
+    MetricGauge latencyGauge_;
+    MetricGauge celsiusGauge_;
+    MetricGauge loadGauge_;
+};
+
+#endif /* QUALITYGOVERNOR_HPP */
@@ -0,0 +1,629 @@
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include "DepthCodec.hpp"
+#include "FrameClock.hpp"
+#include "FrameViews.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Container for combined depth + body recordings.
+//
+// A file starts with a RecordingFileHeader and is followed by records. Each
+// record is a RecordHeader and `byteLength` bytes of payload; all records of
+// one frame share its timestamp and end with a RECORD_FRAME_END record.
+// Timestamps are monotonic nanoseconds (FrameTime). Unknown record types
+// are skipped by the reader, so new record types can be added freely.
+//
+// Version 2 adds what random access needs: payloads are zero-padded to
+// kRecordAlignment, every frame starts on a kRecordPageSize boundary
+// (a RECORD_PADDING record fills the gap), and close() appends a
+// RECORD_INDEX of IndexEntry followed by a RECORD_FOOTER as the very last
+// record. MappedRecording uses the index to seek by timestamp without
+// reading the frames in between; recordings cut short by a crash have no
+// footer and are indexed by a scan instead.
+
+const char kRecordingMagic[8] = { 'D', 'O', 'G', 'R', 'E', 'C', '0', '1' };
+const uint32_t kRecordingVersion = 2;
+const uint32_t kRecordAlignment = 8;
+const uint32_t kRecordPageSize = 4096;
+
+enum RecordType : uint32_t
+{
+    RECORD_DEPTH = 1,      // DepthRecord + pixels in its encoding
+    RECORD_BODIES = 2,     // BodiesRecord + count * astra_body_t
+    RECORD_FLOOR = 3,      // FloorRecord
+    RECORD_MASKS = 4,      // MasksRecord + body mask + floor mask bytes
+    RECORD_FRAME_END = 15,
+    RECORD_PADDING = 16,   // zero bytes up to the next page
+    RECORD_INDEX = 17,     // frame count * IndexEntry
+    RECORD_FOOTER = 18,    // RecordingFooter, always last
+};
+
+struct RecordingFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+};
+
+struct RecordHeader
+{
+    uint32_t type;
+    uint32_t byteLength;
+    int64_t timestamp;
+    int32_t frameIndex;
+    uint32_t reserved;
+};
+
+enum DepthEncoding : uint32_t
+{
+    DEPTH_ENCODING_RAW = 0, // width * height int16
+    DEPTH_ENCODING_RVL = 1, // DepthCodec.hpp, lossless
+};
+
+struct DepthRecord
+{
+    int32_t width;
+    int32_t height;
+    uint32_t encoding; // DepthEncoding
+    uint32_t reserved;
+};
+
+struct BodiesRecord
+{
+    int32_t width;
+    int32_t height;
+    int32_t count;
+    int32_t valid;
+};
+
+struct FloorRecord
+{
+    astra_plane_t plane;
+    int32_t detected;
+    int32_t reserved;
+};
+
+struct MasksRecord
+{
+    int32_t width;
+    int32_t height;
+};
+
+struct IndexEntry
+{
+    int64_t timestamp;
+    uint64_t offset;      // of the frame's first RecordHeader
+    int32_t frameIndex;
+    uint32_t byteLength;  // up to and including the frame-end record
+};
+
+struct RecordingFooter
+{
+    uint64_t indexOffset; // of the RECORD_INDEX header
+    uint64_t frameCount;
+};
+
+inline uint64_t record_padded_length(uint32_t byteLength, uint32_t version)
+{
+    if (version < 2) { return byteLength; }
+    return (static_cast<uint64_t>(byteLength) + kRecordAlignment - 1) & ~static_cast<uint64_t>(kRecordAlignment - 1);
+}
+
+// Whether a record's payload of `byteLength` bytes holds its fixed part of
+// `recordSize` bytes and `extra` bytes after it.
+inline bool record_fits(uint32_t byteLength, size_t recordSize, uint64_t extra = 0)
+{
+    return byteLength >= recordSize && byteLength - recordSize >= extra;
+}
+
+// Depth that is already in its stored encoding, e.g. compressed ahead of
+// time by ClipCapture.
+struct EncodedDepth
+{
+    const void* data{ nullptr };
+    uint32_t bytes{ 0 };
+    DepthEncoding encoding{ DEPTH_ENCODING_RAW };
+    int width{ 0 };
+    int height{ 0 };
+    astra_frame_index_t frameIndex{ 0 };
+
+    bool is_valid() const { return data != nullptr && width > 0 && height > 0; }
+};
+
+// Borrowed view of one frame, valid as long as its source is.
+struct FrameRef
+{
+    FrameTime timestamp{ 0 };
+    DepthView depth;
+    BodyFrameView body;
+};
+
+class FrameRecorder
+{
+public:
+    ~FrameRecorder()
+    {
+        close();
+    }
+
+    bool open(const char* path, bool recordMasks = true)
+    {
+        close();
+        file_ = fopen(path, "wb");
+        if (file_ == nullptr)
+        {
+            printf("Recorder: cannot open %s\n", path);
+            return false;
+        }
+        recordMasks_ = recordMasks;
+        offset_ = 0;
+        index_.clear();
+        // Half an hour at 30 fps before the index has to grow mid-frame.
+        index_.reserve(54000);
+
+        RecordingFileHeader header;
+        std::memcpy(header.magic, kRecordingMagic, sizeof(header.magic));
+        header.version = kRecordingVersion;
+        header.headerSize = sizeof(RecordingFileHeader);
+        return write_bytes(&header, sizeof(header));
+    }
+
+    // Appends the index and footer; a recording that is never closed is
+    // still readable, just without O(1) seeks.
+    void close()
+    {
+        if (file_ == nullptr) { return; }
+
+        const uint32_t indexBytes = static_cast<uint32_t>(index_.size() * sizeof(IndexEntry));
+        RecordingFooter footer = { offset_, index_.size() };
+        const bool ok = write_record(RECORD_INDEX, 0, 0, index_.data(), indexBytes)
+                     && write_record(RECORD_FOOTER, 0, 0, &footer, sizeof(footer));
+        if (!ok)
+        {
+            printf("Recorder: cannot write the frame index\n");
+        }
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    bool is_open() const { return file_ != nullptr; }
+
+    // RVL by default; raw costs ~3x the space for a little less CPU.
+    void set_depth_encoding(DepthEncoding encoding)
+    {
+        depthEncoding_ = encoding;
+    }
+
+    bool write_frame(FrameTime timestamp, const DepthView& depth, const BodyFrameView& body)
+    {
+        EncodedDepth encoded;
+        if (depth.is_valid())
+        {
+            const size_t pixels = static_cast<size_t>(depth.width) * depth.height;
+            encoded.data = depth.data;
+            encoded.bytes = static_cast<uint32_t>(pixels * sizeof(int16_t));
+            encoded.encoding = depthEncoding_;
+            encoded.width = depth.width;
+            encoded.height = depth.height;
+            encoded.frameIndex = depth.frameIndex;
+            if (depthEncoding_ == DEPTH_ENCODING_RVL)
+            {
+                if (encoded_.size() < depth_max_encoded_size(pixels))
+                {
+                    encoded_.resize(depth_max_encoded_size(pixels));
+                }
+                encoded.bytes = static_cast<uint32_t>(depth_encode(depth.data, pixels, encoded_.data()));
+                encoded.data = encoded_.data();
+            }
+        }
+        return write_frame(timestamp, encoded, body);
+    }
+
+    bool write_frame(FrameTime timestamp, const EncodedDepth& depth, const BodyFrameView& body)
+    {
+        TRACE_ZONE("FrameRecorder::write_frame");
+        if (file_ == nullptr) { return false; }
+
+        const int32_t frameIndex = depth.is_valid() ? depth.frameIndex : body.frameIndex;
+        bool ok = pad_to_page();
+        const uint64_t frameStart = offset_;
+
+        if (depth.is_valid())
+        {
+            DepthRecord record = { depth.width, depth.height, depth.encoding, 0 };
+            ok = ok && write_header(RECORD_DEPTH, sizeof(record) + depth.bytes, timestamp, frameIndex)
+                    && write_bytes(&record, sizeof(record))
+                    && write_bytes(depth.data, depth.bytes)
+                    && write_padding(sizeof(record) + depth.bytes);
+        }
+
+        {
+            const int count = body.valid ? body.count : 0;
+            BodiesRecord record = { body.width, body.height, count, body.valid ? 1 : 0 };
+            const uint32_t bytes = count * sizeof(astra_body_t);
+            ok = ok && write_header(RECORD_BODIES, sizeof(record) + bytes, timestamp, frameIndex)
+                    && write_bytes(&record, sizeof(record))
+                    && write_bytes(body.bodies, bytes)
+                    && write_padding(sizeof(record) + bytes);
+        }
+
+        if (body.valid)
+        {
+            FloorRecord record = { body.floorPlane, body.floorDetected ? 1 : 0, 0 };
+            ok = ok && write_record(RECORD_FLOOR, timestamp, frameIndex, &record, sizeof(record));
+        }
+
+        if (recordMasks_ && body.valid && body.bodyMask != nullptr && body.floorMask != nullptr)
+        {
+            MasksRecord record = { body.maskWidth, body.maskHeight };
+            const uint32_t bytes = body.maskWidth * body.maskHeight;
+            ok = ok && write_header(RECORD_MASKS, sizeof(record) + 2 * bytes, timestamp, frameIndex)
+                    && write_bytes(&record, sizeof(record))
+                    && write_bytes(body.bodyMask, bytes)
+                    && write_bytes(body.floorMask, bytes)
+                    && write_padding(sizeof(record) + 2 * bytes);
+        }
+
+        ok = ok && write_header(RECORD_FRAME_END, 0, timestamp, frameIndex);
+        if (!ok)
+        {
+            printf("Recorder: write failed, recording stopped\n");
+            fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+
+        index_.push_back(IndexEntry{ timestamp, frameStart, frameIndex, static_cast<uint32_t>(offset_ - frameStart) });
+        return true;
+    }
+
+private:
+    bool write_header(uint32_t type, uint32_t byteLength, FrameTime timestamp, int32_t frameIndex)
+    {
+        RecordHeader header = { type, byteLength, timestamp, frameIndex, 0 };
+        return write_bytes(&header, sizeof(header));
+    }
+
+    bool write_record(uint32_t type, FrameTime timestamp, int32_t frameIndex, const void* data, uint32_t size)
+    {
+        return write_header(type, size, timestamp, frameIndex)
+            && write_bytes(data, size)
+            && write_padding(size);
+    }
+
+    bool write_bytes(const void* data, size_t size)
+    {
+        if (size != 0 && fwrite(data, 1, size, file_) != size) { return false; }
+        offset_ += size;
+        return true;
+    }
+
+    bool write_zeros(uint64_t size)
+    {
+        static const uint8_t zeros[kRecordPageSize] = { 0 };
+        while (size > 0)
+        {
+            const size_t chunk = size < sizeof(zeros) ? static_cast<size_t>(size) : sizeof(zeros);
+            if (!write_bytes(zeros, chunk)) { return false; }
+            size -= chunk;
+        }
+        return true;
+    }
+
+    bool write_padding(uint32_t byteLength)
+    {
+        return write_zeros(record_padded_length(byteLength, kRecordingVersion) - byteLength);
+    }
+
+    // Starts the next frame on a page boundary so it can be mapped and
+    // read ahead on its own.
+    bool pad_to_page()
+    {
+        uint64_t gap = (kRecordPageSize - offset_ % kRecordPageSize) % kRecordPageSize;
+        if (gap == 0) { return true; }
+        if (gap < sizeof(RecordHeader)) { gap += kRecordPageSize; }
+        const uint32_t bytes = static_cast<uint32_t>(gap - sizeof(RecordHeader));
+        return write_header(RECORD_PADDING, bytes, 0, 0) && write_zeros(bytes);
+    }
+
+    FILE* file_{ nullptr };
+    bool recordMasks_{ true };
+    uint64_t offset_{ 0 };
+    std::vector<IndexEntry> index_;
+    DepthEncoding depthEncoding_{ DEPTH_ENCODING_RVL };
+    std::vector<uint8_t> encoded_;
+};
+
+// Read-only, memory-mapped access to a version 2 recording. Frames are
+// returned as FrameRef views straight into the mapping, so nothing is
+// copied and several processes reading the same file share one page cache.
+class MappedRecording
+{
+public:
+    ~MappedRecording()
+    {
+        close();
+    }
+
+    bool open(const char* path)
+    {
+        close();
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            printf("Recording: cannot open %s\n", path);
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            size_ = static_cast<size_t>(info.st_size);
+            void* map = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            data_ = map == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(map);
+        }
+        ::close(fd);
+
+        RecordingFileHeader header;
+        if (data_ == nullptr || size_ < sizeof(header) ||
+            (std::memcpy(&header, data_, sizeof(header)),
+             std::memcmp(header.magic, kRecordingMagic, sizeof(header.magic)) != 0) ||
+            header.version < 2 || header.headerSize < sizeof(header))
+        {
+            printf("Recording: %s is not a version 2 recording\n", path);
+            close();
+            return false;
+        }
+        firstRecord_ = header.headerSize;
+
+        if (!load_index())
+        {
+            printf("Recording: %s has no index, scanning\n", path);
+            scan_index();
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (data_ != nullptr)
+        {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        index_ = nullptr;
+        frameCount_ = 0;
+        scanned_.clear();
+    }
+
+    bool is_open() const { return data_ != nullptr; }
+    size_t frame_count() const { return frameCount_; }
+
+    FrameTime start_time() const { return frameCount_ > 0 ? index_[0].timestamp : 0; }
+    FrameTime end_time() const { return frameCount_ > 0 ? index_[frameCount_ - 1].timestamp : 0; }
+
+    // Timestamp of frame `i` from the index, without decoding the frame.
+    FrameTime timestamp(size_t i) const { return index_[i].timestamp; }
+
+    // Index of the first frame at or after `timestamp` (frame_count() if
+    // there is none). Frames arrive at a near-constant rate, so the
+    // interpolated probe usually lands next to the answer in one step;
+    // probes alternate with bisection to keep the worst case logarithmic.
+    size_t find(FrameTime timestamp) const
+    {
+        size_t lo = 0;
+        size_t hi = frameCount_;
+        bool interpolate = true;
+        while (lo < hi)
+        {
+            const FrameTime first = index_[lo].timestamp;
+            const FrameTime last = index_[hi - 1].timestamp;
+            if (timestamp <= first) { return lo; }
+            if (timestamp > last) { return hi; }
+
+            size_t probe = lo + (hi - lo) / 2;
+            if (interpolate)
+            {
+                probe = lo + static_cast<size_t>(
+                    static_cast<double>(timestamp - first) / static_cast<double>(last - first) * (hi - 1 - lo));
+            }
+            interpolate = !interpolate;
+
+            if (index_[probe].timestamp < timestamp)
+            {
+                if (index_[probe + 1].timestamp >= timestamp) { return probe + 1; }
+                lo = probe + 1;
+            }
+            else
+            {
+                if (index_[probe - 1].timestamp < timestamp) { return probe; }
+                hi = probe;
+            }
+        }
+        return lo;
+    }
+
+    // Fills `frame` with views into the mapping; false if the frame is
+    // damaged. Pointers stay valid until close(), except compressed depth:
+    // it is decoded into a buffer that the next frame() call reuses.
+    bool frame(size_t i, FrameRef& frame) const
+    {
+        if (i >= frameCount_) { return false; }
+
+        frame = FrameRef();
+        frame.timestamp = index_[i].timestamp;
+        uint64_t offset = index_[i].offset;
+        const uint64_t end = offset + index_[i].byteLength;
+        if (end > size_) { return false; }
+
+        while (offset + sizeof(RecordHeader) <= end)
+        {
+            RecordHeader header;
+            std::memcpy(&header, data_ + offset, sizeof(header));
+            const uint8_t* payload = data_ + offset + sizeof(header);
+            offset += sizeof(header) + record_padded_length(header.byteLength, 2);
+            if (header.type == RECORD_FRAME_END) { return true; }
+            if (offset > end) { return false; }
+
+            switch (header.type) {
+            case RECORD_DEPTH:
+            {
+                // Too short for its own header, the RVL input length below
+                // would wrap around.
+                if (!record_fits(header.byteLength, sizeof(DepthRecord))) { return false; }
+                const DepthRecord* record = reinterpret_cast<const DepthRecord*>(payload);
+                if (record->width < 0 || record->height < 0) { return false; }
+                const size_t pixels = static_cast<size_t>(record->width) * record->height;
+                const uint8_t* data = reinterpret_cast<const uint8_t*>(record + 1);
+                if (record->encoding == DEPTH_ENCODING_RAW)
+                {
+                    if (!record_fits(header.byteLength, sizeof(DepthRecord), pixels * sizeof(int16_t))) { return false; }
+                    frame.depth.data = reinterpret_cast<const int16_t*>(data);
+                }
+                else if (record->encoding == DEPTH_ENCODING_RVL)
+                {
+                    depth_.resize(pixels);
+                    if (!depth_decode(data, header.byteLength - sizeof(DepthRecord), depth_.data(), pixels)) { return false; }
+                    frame.depth.data = depth_.data();
+                }
+                else
+                {
+                    return false;
+                }
+                frame.depth.width = record->width;
+                frame.depth.height = record->height;
+                frame.depth.frameIndex = header.frameIndex;
+                break;
+            }
+            case RECORD_BODIES:
+            {
+                const BodiesRecord* record = reinterpret_cast<const BodiesRecord*>(payload);
+                if (!record_fits(header.byteLength, sizeof(BodiesRecord))) { return false; }
+                if (record->count < 0 || record->count > ASTRA_MAX_BODIES) { return false; }
+                if (!record_fits(header.byteLength, sizeof(BodiesRecord), record->count * sizeof(astra_body_t))) { return false; }
+                frame.body.valid = record->valid != 0;
+                frame.body.frameIndex = header.frameIndex;
+                frame.body.width = record->width;
+                frame.body.height = record->height;
+                frame.body.count = record->count;
+                frame.body.bodies = reinterpret_cast<const astra_body_t*>(record + 1);
+                break;
+            }
+            case RECORD_FLOOR:
+            {
+                const FloorRecord* record = reinterpret_cast<const FloorRecord*>(payload);
+                if (!record_fits(header.byteLength, sizeof(FloorRecord))) { return false; }
+                frame.body.floorPlane = record->plane;
+                frame.body.floorDetected = record->detected != 0;
+                break;
+            }
+            case RECORD_MASKS:
+            {
+                const MasksRecord* record = reinterpret_cast<const MasksRecord*>(payload);
+                if (!record_fits(header.byteLength, sizeof(MasksRecord))) { return false; }
+                if (record->width < 0 || record->height < 0 ||
+                    !record_fits(header.byteLength, sizeof(MasksRecord), 2ull * record->width * record->height))
+                {
+                    return false;
+                }
+                const uint8_t* masks = reinterpret_cast<const uint8_t*>(record + 1);
+                frame.body.bodyMask = masks;
+                frame.body.floorMask = masks + static_cast<size_t>(record->width) * record->height;
+                frame.body.maskWidth = record->width;
+                frame.body.maskHeight = record->height;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        return false;
+    }
+
+    // Hints the kernel to read frames [first, first + count) ahead of use.
+    void prefetch(size_t first, size_t count) const
+    {
+        if (first >= frameCount_ || count == 0) { return; }
+        const size_t last = std::min(first + count, frameCount_) - 1;
+        const uint64_t begin = index_[first].offset;
+        const uint64_t end = index_[last].offset + index_[last].byteLength;
+        madvise(const_cast<uint8_t*>(data_) + begin, static_cast<size_t>(end - begin), MADV_WILLNEED);
+    }
+
+private:
+    bool load_index()
+    {
+        const size_t tail = sizeof(RecordHeader) + sizeof(RecordingFooter);
+        if (size_ < firstRecord_ + tail) { return false; }
+
+        RecordHeader header;
+        RecordingFooter footer;
+        std::memcpy(&header, data_ + size_ - tail, sizeof(header));
+        std::memcpy(&footer, data_ + size_ - sizeof(footer), sizeof(footer));
+        if (header.type != RECORD_FOOTER || header.byteLength != sizeof(footer)) { return false; }
+
+        const uint64_t indexBytes = footer.frameCount * sizeof(IndexEntry);
+        if (footer.indexOffset + sizeof(RecordHeader) + indexBytes > size_ - tail) { return false; }
+        std::memcpy(&header, data_ + footer.indexOffset, sizeof(header));
+        if (header.type != RECORD_INDEX || header.byteLength != indexBytes) { return false; }
+
+        index_ = reinterpret_cast<const IndexEntry*>(data_ + footer.indexOffset + sizeof(RecordHeader));
+        frameCount_ = static_cast<size_t>(footer.frameCount);
+        return true;
+    }
+
+    // Rebuilds the index of an unfinished recording from its records,
+    // stopping at the first truncated one.
+    void scan_index()
+    {
+        scanned_.clear();
+        uint64_t offset = firstRecord_;
+        uint64_t frameStart = 0;
+        bool inFrame = false;
+        while (offset + sizeof(RecordHeader) <= size_)
+        {
+            RecordHeader header;
+            std::memcpy(&header, data_ + offset, sizeof(header));
+            const uint64_t next = offset + sizeof(header) + record_padded_length(header.byteLength, 2);
+            if (next > size_) { break; }
+
+            if (header.type == RECORD_PADDING || header.type == RECORD_INDEX || header.type == RECORD_FOOTER)
+            {
+                inFrame = false;
+            }
+            else
+            {
+                if (!inFrame) { frameStart = offset; inFrame = true; }
+                if (header.type == RECORD_FRAME_END)
+                {
+                    scanned_.push_back(IndexEntry{ header.timestamp, frameStart, header.frameIndex,
+                                                   static_cast<uint32_t>(next - frameStart) });
+                    inFrame = false;
+                }
+            }
+            offset = next;
+        }
+        index_ = scanned_.data();
+        frameCount_ = scanned_.size();
+    }
+
+    const uint8_t* data_{ nullptr };
+    size_t size_{ 0 };
+    uint64_t firstRecord_{ 0 };
+    const IndexEntry* index_{ nullptr };
+    size_t frameCount_{ 0 };
+    std::vector<IndexEntry> scanned_;
+    mutable std::vector<int16_t> depth_;
+};
+
+#endif /* RECORDING_HPP */
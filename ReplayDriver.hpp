@@ -0,0 +1,130 @@
+#ifndef REPLAYDRIVER_HPP
+#define REPLAYDRIVER_HPP
+
+#include "FrameClock.hpp"
+#include "Recording.hpp"
+#include <cstdio>
+
+// Feeds a MappedRecording to a frame sink.
+//
+// The pipeline only ever sees the recorded timestamps, never the wall
+// clock, so temporal filters and classifiers produce the same output
+// whatever the replay speed. `speed` is a multiple of real time; 0 (or
+// less) replays as fast as the sink consumes frames.
+class ReplayDriver
+{
+public:
+    struct Stats
+    {
+        size_t frames{ 0 };
+        size_t damaged{ 0 };
+        FrameTime busy{ 0 };        // wall time spent inside the sink
+        FrameTime elapsed{ 0 };     // wall time since start()
+        FrameTime recorded{ 0 };    // recording time covered
+    };
+
+    explicit ReplayDriver(const MappedRecording& recording, double speed = 1.0)
+        : recording_(recording),
+          speed_(speed)
+    { }
+
+    bool is_unthrottled() const { return speed_ <= 0.0; }
+    bool is_finished() const { return next_ >= recording_.frame_count(); }
+    const Stats& stats() const { return stats_; }
+
+    // Starts `offset` nanoseconds into the recording.
+    void start(FrameTime offset, FrameTime wallNow)
+    {
+        next_ = recording_.find(recording_.start_time() + offset);
+        first_ = next_ < recording_.frame_count() ? recording_.start_time() + offset : 0;
+        started_ = wallNow;
+        stats_ = Stats();
+        recording_.prefetch(next_, kPrefetchFrames);
+    }
+
+    // Hands the sink every frame due at `wallNow`. Unthrottled, frames are
+    // due immediately and the call returns once `budget` of wall time is
+    // used up, so an interactive caller still gets to draw.
+    template<typename Sink>
+    size_t pump(FrameTime wallNow, Sink&& sink, FrameTime budget = 50000000LL)
+    {
+        size_t delivered = 0;
+        FrameRef frame;
+        while (!is_finished())
+        {
+            // Decide from the index first; frame() decodes the depth.
+            const size_t i = next_;
+            if (is_unthrottled())
+            {
+                if (frame_clock_now() - wallNow >= budget && delivered > 0) { break; }
+            }
+            else if (due_time(recording_.timestamp(i)) > wallNow)
+            {
+                break;
+            }
+
+            if (!recording_.frame(i, frame))
+            {
+                stats_.damaged++;
+                next_++;
+                continue;
+            }
+
+            const FrameTime begin = frame_clock_now();
+            sink(frame);
+            stats_.busy += frame_clock_now() - begin;
+            stats_.frames++;
+            stats_.recorded = frame.timestamp - first_;
+            delivered++;
+
+            next_++;
+            if (next_ % kPrefetchFrames == 0)
+            {
+                recording_.prefetch(next_, kPrefetchFrames);
+            }
+        }
+        stats_.elapsed = frame_clock_now() - started_;
+        return delivered;
+    }
+
+    // Replays everything left as fast as the sink allows.
+    template<typename Sink>
+    const Stats& run(Sink&& sink)
+    {
+        while (!is_finished())
+        {
+            pump(frame_clock_now(), sink, 1000000000LL);
+        }
+        return stats_;
+    }
+
+    void print_report() const
+    {
+        const double busy = frame_time_seconds(stats_.busy);
+        const double elapsed = frame_time_seconds(stats_.elapsed);
+        const double recorded = frame_time_seconds(stats_.recorded);
+        printf("Replay: %zu frames (%zu damaged), %.2f s recorded in %.2f s\n",
+               stats_.frames, stats_.damaged, recorded, elapsed);
+        printf("Replay: %.1f frames/s processing, %.1f frames/s overall, %.2fx real time\n",
+               busy > 0.0 ? stats_.frames / busy : 0.0,
+               elapsed > 0.0 ? stats_.frames / elapsed : 0.0,
+               elapsed > 0.0 ? recorded / elapsed : 0.0);
+    }
+
+private:
+    static const size_t kPrefetchFrames = 64;
+
+    FrameTime due_time(FrameTime timestamp) const
+    {
+        return started_ + static_cast<FrameTime>((timestamp - first_) / speed_);
+    }
+
+    const MappedRecording& recording_;
+    double speed_;
+    size_t next_{ 0 };
+    FrameTime first_{ 0 };
+    FrameTime started_{ 0 };
+    Stats stats_;
+};
+
+#endif /* REPLAYDRIVER_HPP */
@@ -0,0 +1,345 @@
+#ifndef SKELETONPACKET_HPP
+#define SKELETONPACKET_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Compact format for a frame's bodies, for logging and for the offload
+// link when depth isn't needed.
+//
+// Only what the analysis uses is kept: id, tracking status, centre of
+// mass and joint world positions, in whole millimetres as int16. Joint
+// status takes two bits per joint; untracked joints carry no position.
+// A body seen in the previous frame is coded as zigzag varint deltas
+// against it, which is a byte per value for someone moving at walking
+// pace; a new body, or one whose deltas would come out larger, is coded
+// as plain int16s. Every `keyInterval` frames all bodies are coded plain
+// so a reader can join mid-stream.
+//
+//   uint16  sequence
+//   uint8   body count, top bit set on a key frame
+//   body *  id, flags (bit 0 plain, bits 1-2 body status),
+//           5 bytes joint status, values (centre of mass, then joints)
+//   uint16  Fletcher-16 of everything before it
+//
+// All multi-byte fields are little-endian. Encoder and decoder keep the
+// quantized previous frame in fixed arrays and never allocate.
+
+const int kSkeletonValues = 3 * (ASTRA_MAX_JOINTS + 1);
+const size_t kSkeletonStatusBytes = (2 * ASTRA_MAX_JOINTS + 7) / 8;
+const size_t kSkeletonBodyMaxBytes = 2 + kSkeletonStatusBytes + kSkeletonValues * sizeof(int16_t);
+const size_t kSkeletonPacketMaxBytes = 3 + ASTRA_MAX_BODIES * kSkeletonBodyMaxBytes + 2;
+
+namespace skeleton_detail {
+
+// Quantized state of one body, as both ends see it after a frame.
+struct BodyState
+{
+    astra_body_id_t id{ 0 };
+    uint8_t status[ASTRA_MAX_JOINTS];
+    int16_t values[kSkeletonValues];
+};
+
+struct FrameState
+{
+    int count{ 0 };
+    BodyState bodies[ASTRA_MAX_BODIES];
+
+    const BodyState* find(astra_body_id_t id) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (bodies[i].id == id) { return &bodies[i]; }
+        }
+        return nullptr;
+    }
+};
+
+// Centre of mass always has a position, joints only when tracked.
+inline bool has_value(const BodyState& state, int k)
+{
+    return k < 3 || state.status[(k - 3) / 3] != ASTRA_JOINT_STATUS_NOT_TRACKED;
+}
+
+inline int16_t quantize(float mm)
+{
+    return static_cast<int16_t>(std::lround(std::min(std::max(mm, -32768.f), 32767.f)));
+}
+
+inline uint32_t zigzag(int32_t v)
+{
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t unzigzag(uint32_t v)
+{
+    return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+inline size_t varint_size(uint32_t v)
+{
+    return v < 0x80 ? 1 : (v < 0x4000 ? 2 : 3);
+}
+
+inline uint16_t fletcher16(const uint8_t* data, size_t bytes)
+{
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        a = (a + data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return static_cast<uint16_t>(b << 8 | a);
+}
+
+} // namespace skeleton_detail
+
+class SkeletonEncoder
+{
+public:
+    explicit SkeletonEncoder(int keyInterval = 30)
+        : keyInterval_(std::max(keyInterval, 1))
+    { }
+
+    // Makes the next frame a key frame, e.g. for a new receiver.
+    void reset()
+    {
+        sinceKey_ = keyInterval_;
+        previous_.count = 0;
+    }
+
+    // Encodes up to ASTRA_MAX_BODIES bodies into `out`, which must hold
+    // kSkeletonPacketMaxBytes. Returns the packet size.
+    size_t encode(const astra_body_t* bodies, int count, uint8_t* out)
+    {
+        using namespace skeleton_detail;
+
+        count = std::min(std::max(count, 0), static_cast<int>(ASTRA_MAX_BODIES));
+        const bool key = sinceKey_ >= keyInterval_;
+        sinceKey_ = key ? 1 : sinceKey_ + 1;
+        sequence_++;
+
+        uint8_t* p = out;
+        *p++ = static_cast<uint8_t>(sequence_);
+        *p++ = static_cast<uint8_t>(sequence_ >> 8);
+        *p++ = static_cast<uint8_t>(count | (key ? 0x80 : 0));
+
+        current_.count = count;
+        for (int i = 0; i < count; i++)
+        {
+            p = encode_body(bodies[i], key ? nullptr : previous_.find(bodies[i].id), current_.bodies[i], p);
+        }
+        std::swap(current_, previous_);
+
+        const uint16_t sum = fletcher16(out, static_cast<size_t>(p - out));
+        *p++ = static_cast<uint8_t>(sum);
+        *p++ = static_cast<uint8_t>(sum >> 8);
+        return static_cast<size_t>(p - out);
+    }
+
+private:
+    static uint8_t* encode_body(const astra_body_t& body, const skeleton_detail::BodyState* reference,
+                                skeleton_detail::BodyState& state, uint8_t* p)
+    {
+        using namespace skeleton_detail;
+
+        state.id = body.id;
+        state.values[0] = quantize(body.centerOfMass.x);
+        state.values[1] = quantize(body.centerOfMass.y);
+        state.values[2] = quantize(body.centerOfMass.z);
+        uint8_t statusBytes[kSkeletonStatusBytes] = { 0 };
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            const astra_joint_t& joint = body.joints[j];
+            const uint8_t status = std::min<uint8_t>(joint.status, ASTRA_JOINT_STATUS_TRACKED);
+            state.status[j] = status;
+            statusBytes[j / 4] |= static_cast<uint8_t>(status << (2 * (j % 4)));
+
+            int16_t* v = &state.values[3 + 3 * j];
+            const bool tracked = status != ASTRA_JOINT_STATUS_NOT_TRACKED;
+            v[0] = tracked ? quantize(joint.worldPosition.x) : 0;
+            v[1] = tracked ? quantize(joint.worldPosition.y) : 0;
+            v[2] = tracked ? quantize(joint.worldPosition.z) : 0;
+        }
+
+        // Deltas only pay off while they are smaller than the plain values.
+        uint32_t deltas[kSkeletonValues];
+        int valueCount = 0;
+        size_t deltaBytes = 0;
+        for (int k = 0; k < kSkeletonValues; k++)
+        {
+            if (!has_value(state, k)) { continue; }
+            if (reference != nullptr)
+            {
+                deltas[valueCount] = zigzag(state.values[k] - reference->values[k]);
+                deltaBytes += varint_size(deltas[valueCount]);
+            }
+            valueCount++;
+        }
+        const bool plain = reference == nullptr || deltaBytes >= valueCount * sizeof(int16_t);
+
+        *p++ = body.id;
+        *p++ = static_cast<uint8_t>((plain ? 1 : 0) | (std::min<uint8_t>(body.status, 3) << 1));
+        std::memcpy(p, statusBytes, kSkeletonStatusBytes);
+        p += kSkeletonStatusBytes;
+
+        if (plain)
+        {
+            for (int k = 0; k < kSkeletonValues; k++)
+            {
+                if (!has_value(state, k)) { continue; }
+                const uint16_t v = static_cast<uint16_t>(state.values[k]);
+                *p++ = static_cast<uint8_t>(v);
+                *p++ = static_cast<uint8_t>(v >> 8);
+            }
+            return p;
+        }
+
+        for (int k = 0; k < valueCount; k++)
+        {
+            uint32_t v = deltas[k];
+            while (v >= 0x80)
+            {
+                *p++ = static_cast<uint8_t>(v | 0x80);
+                v >>= 7;
+            }
+            *p++ = static_cast<uint8_t>(v);
+        }
+        return p;
+    }
+
+    int keyInterval_;
+    int sinceKey_{ 1 << 30 };
+    uint16_t sequence_{ 0 };
+    skeleton_detail::FrameState previous_;
+    skeleton_detail::FrameState current_;
+};
+
+class SkeletonDecoder
+{
+public:
+    // Forgets the previous frame; decoding resumes at the next key frame.
+    void reset()
+    {
+        synced_ = false;
+        previous_.count = 0;
+    }
+
+    // Decodes a packet into `out`. False on a bad checksum, truncated
+    // input, or a delta against a frame this decoder didn't see; `out` is
+    // unspecified then.
+    bool decode(const uint8_t* in, size_t bytes, astra_body_list_t& out)
+    {
+        using namespace skeleton_detail;
+
+        if (bytes < 5) { return false; }
+        const uint16_t sum = static_cast<uint16_t>(in[bytes - 2] | in[bytes - 1] << 8);
+        if (fletcher16(in, bytes - 2) != sum) { return false; }
+
+        const uint8_t* p = in;
+        const uint8_t* const end = in + bytes - 2;
+        const uint16_t sequence = static_cast<uint16_t>(p[0] | p[1] << 8);
+        const int count = p[2] & 0x7f;
+        p += 3;
+        if (count > ASTRA_MAX_BODIES) { return false; }
+
+        const bool follows = synced_ && sequence == static_cast<uint16_t>(sequence_ + 1);
+        current_.count = count;
+        out.count = count;
+        for (int i = 0; i < count; i++)
+        {
+            p = decode_body(p, end, follows ? &previous_ : nullptr, current_.bodies[i], out.bodies[i]);
+            if (p == nullptr)
+            {
+                reset();
+                return false;
+            }
+        }
+        if (p != end)
+        {
+            reset();
+            return false;
+        }
+
+        std::swap(current_, previous_);
+        sequence_ = sequence;
+        synced_ = true;
+        return true;
+    }
+
+private:
+    static const uint8_t* decode_body(const uint8_t* p, const uint8_t* end,
+                                      const skeleton_detail::FrameState* previous,
+                                      skeleton_detail::BodyState& state, astra_body_t& body)
+    {
+        using namespace skeleton_detail;
+
+        if (end - p < static_cast<ptrdiff_t>(2 + kSkeletonStatusBytes)) { return nullptr; }
+        state.id = p[0];
+        const bool plain = (p[1] & 1) != 0;
+        const uint8_t bodyStatus = static_cast<uint8_t>((p[1] >> 1) & 3);
+        const uint8_t* statusBytes = p + 2;
+        p += 2 + kSkeletonStatusBytes;
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            state.status[j] = static_cast<uint8_t>((statusBytes[j / 4] >> (2 * (j % 4))) & 3);
+        }
+
+        const BodyState* reference = previous != nullptr ? previous->find(state.id) : nullptr;
+        if (!plain && reference == nullptr) { return nullptr; }
+
+        for (int k = 0; k < kSkeletonValues; k++)
+        {
+            if (!has_value(state, k))
+            {
+                state.values[k] = 0;
+                continue;
+            }
+            if (plain)
+            {
+                if (end - p < 2) { return nullptr; }
+                state.values[k] = static_cast<int16_t>(p[0] | p[1] << 8);
+                p += 2;
+                continue;
+            }
+
+            uint32_t v = 0;
+            for (int shift = 0; ; shift += 7)
+            {
+                if (p == end || shift > 14) { return nullptr; }
+                const uint8_t byte = *p++;
+                v |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) { break; }
+            }
+            state.values[k] = static_cast<int16_t>(reference->values[k] + unzigzag(v));
+        }
+
+        std::memset(&body, 0, sizeof(body));
+        body.id = state.id;
+        body.status = bodyStatus;
+        body.features = ASTRA_BODY_TRACKING_JOINTS;
+        body.centerOfMass = { static_cast<float>(state.values[0]),
+                              static_cast<float>(state.values[1]),
+                              static_cast<float>(state.values[2]) };
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            astra_joint_t& joint = body.joints[j];
+            const int16_t* v = &state.values[3 + 3 * j];
+            joint.type = static_cast<astra_joint_type_t>(j);
+            joint.status = state.status[j];
+            joint.worldPosition = { static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2]) };
+        }
+        return p;
+    }
+
+    bool synced_{ false };
+    uint16_t sequence_{ 0 };
+    skeleton_detail::FrameState previous_;
+    skeleton_detail::FrameState current_;
+};
+
+#endif /* SKELETONPACKET_HPP */
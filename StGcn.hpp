@@ -0,0 +1,768 @@
+#ifndef STGCN_HPP
+#define STGCN_HPP
+
+#include <astra/capi/streams/body_types.h>
+#include "FrameArena.hpp"
+#include "ParallelBands.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// CPU inference for a spatial-temporal graph convolution network (ST-GCN)
+// over the 19-joint Astra skeleton.
+//
+// Every block is: spatial graph conv over 3 adjacency partitions, ReLU,
+// causal temporal conv (stride 1), residual, ReLU. Batch norm is expected to
+// be folded into the weights by the exporter. Because the temporal convs are
+// causal, a new frame only needs the newest timestep of every block; older
+// timesteps are kept in per-block rings. The head averages the last block
+// over all joints and the last `poolWindow` frames with a running sum.
+
+namespace stgcn {
+
+const int kJoints = ASTRA_MAX_JOINTS;
+const int kPartitions = 3;
+const int kCenterJoint = ASTRA_JOINT_BASE_SPINE;
+
+struct Edge { int a; int b; };
+
+// Same bones the body overlay draws.
+constexpr Edge kBones[] = {
+    { ASTRA_JOINT_HEAD, ASTRA_JOINT_NECK },
+    { ASTRA_JOINT_NECK, ASTRA_JOINT_SHOULDER_SPINE },
+    { ASTRA_JOINT_SHOULDER_SPINE, ASTRA_JOINT_LEFT_SHOULDER },
+    { ASTRA_JOINT_LEFT_SHOULDER, ASTRA_JOINT_LEFT_ELBOW },
+    { ASTRA_JOINT_LEFT_ELBOW, ASTRA_JOINT_LEFT_WRIST },
+    { ASTRA_JOINT_LEFT_WRIST, ASTRA_JOINT_LEFT_HAND },
+    { ASTRA_JOINT_SHOULDER_SPINE, ASTRA_JOINT_RIGHT_SHOULDER },
+    { ASTRA_JOINT_RIGHT_SHOULDER, ASTRA_JOINT_RIGHT_ELBOW },
+    { ASTRA_JOINT_RIGHT_ELBOW, ASTRA_JOINT_RIGHT_WRIST },
+    { ASTRA_JOINT_RIGHT_WRIST, ASTRA_JOINT_RIGHT_HAND },
+    { ASTRA_JOINT_SHOULDER_SPINE, ASTRA_JOINT_MID_SPINE },
+    { ASTRA_JOINT_MID_SPINE, ASTRA_JOINT_BASE_SPINE },
+    { ASTRA_JOINT_BASE_SPINE, ASTRA_JOINT_LEFT_HIP },
+    { ASTRA_JOINT_LEFT_HIP, ASTRA_JOINT_LEFT_KNEE },
+    { ASTRA_JOINT_LEFT_KNEE, ASTRA_JOINT_LEFT_FOOT },
+    { ASTRA_JOINT_BASE_SPINE, ASTRA_JOINT_RIGHT_HIP },
+    { ASTRA_JOINT_RIGHT_HIP, ASTRA_JOINT_RIGHT_KNEE },
+    { ASTRA_JOINT_RIGHT_KNEE, ASTRA_JOINT_RIGHT_FOOT },
+};
+constexpr int kBoneCount = sizeof(kBones) / sizeof(kBones[0]);
+
+// Normalised adjacency split into the ST-GCN "spatial configuration"
+// partitions (self, centripetal, centrifugal), stored as one CSR matrix per
+// partition: row v lists the joints u that feed joint v and their weights.
+struct SparseAdjacency
+{
+    int rowStart[kPartitions][kJoints + 1];
+    int col[kPartitions][kJoints * 2];
+    float weight[kPartitions][kJoints * 2];
+};
+
+constexpr SparseAdjacency make_adjacency()
+{
+    SparseAdjacency adj{};
+
+    // Hop distance to the centre joint.
+    int hops[kJoints] = {};
+    for (int v = 0; v < kJoints; v++) { hops[v] = kJoints; }
+    hops[kCenterJoint] = 0;
+    for (int pass = 0; pass < kJoints; pass++)
+    {
+        for (int e = 0; e < kBoneCount; e++)
+        {
+            const int a = kBones[e].a;
+            const int b = kBones[e].b;
+            if (hops[a] + 1 < hops[b]) { hops[b] = hops[a] + 1; }
+            if (hops[b] + 1 < hops[a]) { hops[a] = hops[b] + 1; }
+        }
+    }
+
+    int degree[kJoints] = {};
+    for (int v = 0; v < kJoints; v++) { degree[v] = 1; }
+    for (int e = 0; e < kBoneCount; e++)
+    {
+        degree[kBones[e].a]++;
+        degree[kBones[e].b]++;
+    }
+
+    int fill[kPartitions] = {};
+    for (int v = 0; v < kJoints; v++)
+    {
+        for (int p = 0; p < kPartitions; p++) { adj.rowStart[p][v] = fill[p]; }
+
+        adj.col[0][fill[0]] = v;
+        adj.weight[0][fill[0]] = 1.f / degree[v];
+        fill[0]++;
+
+        for (int e = 0; e < kBoneCount; e++)
+        {
+            int u = -1;
+            if (kBones[e].a == v) { u = kBones[e].b; }
+            else if (kBones[e].b == v) { u = kBones[e].a; }
+            if (u < 0) { continue; }
+
+            const int p = hops[u] < hops[v] ? 1 : 2;
+            adj.col[p][fill[p]] = u;
+            adj.weight[p][fill[p]] = 1.f / degree[v];
+            fill[p]++;
+        }
+    }
+    for (int p = 0; p < kPartitions; p++) { adj.rowStart[p][kJoints] = fill[p]; }
+
+    return adj;
+}
+
+constexpr SparseAdjacency kAdjacency = make_adjacency();
+
+inline float half_to_float(std::uint16_t h)
+{
+    const std::uint32_t sign = (h & 0x8000u) << 16;
+    std::uint32_t exponent = (h >> 10) & 0x1F;
+    std::uint32_t mantissa = h & 0x3FF;
+    std::uint32_t bits;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // Subnormal: renormalise.
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3FF;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    }
+    else if (exponent == 0x1F)
+    {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+struct Block
+{
+    int inChannels{ 0 };
+    int outChannels{ 0 };
+    int temporalKernel{ 1 };
+
+    std::vector<float> spatialWeight;  // [partition][in][out]
+    std::vector<float> spatialBias;    // [out]
+    std::vector<float> temporalWeight; // [tap][out][out], tap 0 = newest frame
+    std::vector<float> temporalBias;   // [out]
+    std::vector<float> residualWeight; // [in][out], empty when identity
+    std::vector<float> residualBias;   // [out]
+};
+
+// Immutable weights; one model can be shared by any number of streams and
+// threads.
+//
+// File layout (stgcn_model.bin). All fields are little endian and packed,
+// with no padding or alignment:
+//   "STGC" u32 version(1) u32 joints(19) u32 inChannels u32 classes
+//   u32 blocks u32 poolWindow
+//   per block: u32 in u32 out u32 temporalKernel u32 hasResidualConv
+//              tensors spatialW spatialB temporalW temporalB [residualW residualB]
+//   tensors fcW [lastOut][classes] fcB [classes]
+// Joints are in astra_joint_type_t order. The input channels are x, y, z of
+// each joint relative to the base spine, in metres (body_to_input()); with
+// fewer than 3 channels the trailing ones are dropped. The first block's
+// `in` must be inChannels and every later one the previous block's `out`;
+// a block with in != out needs the residual conv. Tensor shapes are those
+// listed in Block, row-major with the last index fastest, so weights are
+// [in][out] where PyTorch keeps [out][in]. The spatial weights are per
+// partition (self, centripetal, centrifugal; see make_adjacency()) and the
+// temporal taps start with the newest frame, the reverse of PyTorch's
+// kernel order. To drive the dog's alarm, classes must be ACTION_COUNT, in
+// ActionClass order.
+//
+// A tensor is u8 type (0 = f32, 1 = f16, 2 = int8) u32 count, then for int8
+// u32 scaleCount f32 scales[scaleCount] i8 data[count] (scales repeat over
+// the innermost dimension), for f16 u16 data[count], for f32 f32 data[count].
+// Weights are dequantized once at load; inference runs in float.
+//
+// Sizes are bounded (see kMaxBlocks and friends) well above any model this
+// runs in real time, so a damaged file is rejected instead of allocating
+// gigabytes or wrapping a tensor size.
+class Model
+{
+public:
+    bool load(const char* path)
+    {
+        FILE* fp = fopen(path, "rb");
+        if (fp == nullptr)
+        {
+            return false;
+        }
+
+        const bool ok = read_model(fp);
+        fclose(fp);
+        if (!ok)
+        {
+            printf("ST-GCN: failed to load model %s\n", path);
+            blocks_.clear();
+        }
+        return ok;
+    }
+
+    bool is_loaded() const { return !blocks_.empty(); }
+    int in_channels() const { return inChannels_; }
+    int class_count() const { return classCount_; }
+    int pool_window() const { return poolWindow_; }
+    const std::vector<Block>& blocks() const { return blocks_; }
+    const std::vector<float>& fc_weight() const { return fcWeight_; }
+    const std::vector<float>& fc_bias() const { return fcBias_; }
+
+private:
+    static const std::uint32_t kMaxBlocks = 64;
+    static const std::uint32_t kMaxChannels = 1024;
+    static const std::uint32_t kMaxTemporalKernel = 64;
+    static const std::uint32_t kMaxClasses = 1024;
+    static const std::uint32_t kMaxPoolWindow = 4096;
+
+    // a * b * c as a tensor element count; false if it can't be one.
+    static bool tensor_count(std::size_t a, std::size_t b, std::size_t c, std::size_t& count)
+    {
+        const std::size_t limit = UINT32_MAX;
+        if (a == 0 || b == 0 || c == 0 || a > limit || b > limit / a || c > limit / (a * b)) { return false; }
+        count = a * b * c;
+        return true;
+    }
+
+    template<typename T>
+    static bool read_value(FILE* fp, T& value)
+    {
+        return fread(&value, sizeof(T), 1, fp) == 1;
+    }
+
+    static bool read_tensor(FILE* fp, std::vector<float>& out, std::size_t expected)
+    {
+        std::uint8_t type = 0;
+        std::uint32_t count = 0;
+        if (!read_value(fp, type) || !read_value(fp, count) || count != expected)
+        {
+            return false;
+        }
+
+        out.resize(count);
+        if (type == 0)
+        {
+            return fread(out.data(), sizeof(float), count, fp) == count;
+        }
+        if (type == 1)
+        {
+            std::vector<std::uint16_t> half(count);
+            if (fread(half.data(), sizeof(std::uint16_t), count, fp) != count) { return false; }
+            for (std::uint32_t i = 0; i < count; i++) { out[i] = half_to_float(half[i]); }
+            return true;
+        }
+        if (type == 2)
+        {
+            std::uint32_t scaleCount = 0;
+            if (!read_value(fp, scaleCount) || scaleCount == 0 || scaleCount > count || count % scaleCount != 0)
+            {
+                return false;
+            }
+            std::vector<float> scales(scaleCount);
+            std::vector<std::int8_t> q(count);
+            if (fread(scales.data(), sizeof(float), scaleCount, fp) != scaleCount) { return false; }
+            if (fread(q.data(), 1, count, fp) != count) { return false; }
+            for (std::uint32_t i = 0; i < count; i++) { out[i] = q[i] * scales[i % scaleCount]; }
+            return true;
+        }
+        return false;
+    }
+
+    bool read_model(FILE* fp)
+    {
+        char magic[4];
+        std::uint32_t version = 0, joints = 0, inChannels = 0, classes = 0, blockCount = 0, poolWindow = 0;
+        if (fread(magic, 1, 4, fp) != 4 || std::memcmp(magic, "STGC", 4) != 0) { return false; }
+        if (!read_value(fp, version) || version != 1) { return false; }
+        if (!read_value(fp, joints) || joints != kJoints) { return false; }
+        if (!read_value(fp, inChannels) || !read_value(fp, classes) ||
+            !read_value(fp, blockCount) || !read_value(fp, poolWindow))
+        {
+            return false;
+        }
+        if (inChannels == 0 || classes == 0 || blockCount == 0 || poolWindow == 0) { return false; }
+        if (inChannels > kMaxChannels || classes > kMaxClasses || blockCount > kMaxBlocks ||
+            poolWindow > kMaxPoolWindow)
+        {
+            return false;
+        }
+
+        inChannels_ = inChannels;
+        classCount_ = classes;
+        poolWindow_ = poolWindow;
+        blocks_.assign(blockCount, Block());
+
+        std::uint32_t prevOut = inChannels;
+        for (auto& block : blocks_)
+        {
+            std::uint32_t in = 0, out = 0, kt = 0, hasResidual = 0;
+            if (!read_value(fp, in) || !read_value(fp, out) ||
+                !read_value(fp, kt) || !read_value(fp, hasResidual))
+            {
+                return false;
+            }
+            if (in != prevOut || out == 0 || kt == 0) { return false; }
+            if (out > kMaxChannels || kt > kMaxTemporalKernel) { return false; }
+            if (in != out && !hasResidual) { return false; }
+
+            std::size_t spatialCount = 0, temporalCount = 0, residualCount = 0;
+            if (!tensor_count(kPartitions, in, out, spatialCount) ||
+                !tensor_count(kt, out, out, temporalCount) ||
+                !tensor_count(1, in, out, residualCount))
+            {
+                return false;
+            }
+
+            block.inChannels = in;
+            block.outChannels = out;
+            block.temporalKernel = kt;
+            if (!read_tensor(fp, block.spatialWeight, spatialCount) ||
+                !read_tensor(fp, block.spatialBias, out) ||
+                !read_tensor(fp, block.temporalWeight, temporalCount) ||
+                !read_tensor(fp, block.temporalBias, out))
+            {
+                return false;
+            }
+            if (hasResidual &&
+                (!read_tensor(fp, block.residualWeight, residualCount) ||
+                 !read_tensor(fp, block.residualBias, out)))
+            {
+                return false;
+            }
+            prevOut = out;
+        }
+
+        std::size_t fcCount = 0;
+        return tensor_count(1, prevOut, classes, fcCount) &&
+               read_tensor(fp, fcWeight_, fcCount) &&
+               read_tensor(fp, fcBias_, classes);
+    }
+
+    int inChannels_{ 0 };
+    int classCount_{ 0 };
+    int poolWindow_{ 0 };
+    std::vector<Block> blocks_;
+    std::vector<float> fcWeight_;
+    std::vector<float> fcBias_;
+};
+
+// Per-body inference state. step() consumes one frame and returns class
+// probabilities for the window ending at that frame.
+class Stream
+{
+public:
+    explicit Stream(const Model& model)
+        : model_(&model)
+    {
+        const auto& blocks = model.blocks();
+        int widest = model.in_channels();
+        for (const auto& block : blocks)
+        {
+            BlockState state;
+            state.ring.assign(block.temporalKernel * kJoints * block.outChannels, 0.f);
+            states_.push_back(std::move(state));
+            widest = std::max(widest, block.outChannels);
+        }
+
+        const int lastOut = blocks.back().outChannels;
+        widest_ = widest;
+        pooledRing_.assign(model.pool_window() * lastOut, 0.f);
+        pooledSum_.assign(lastOut, 0.f);
+        probabilities_.assign(model.class_count(), 0.f);
+    }
+
+    void reset()
+    {
+        for (auto& state : states_)
+        {
+            std::fill(state.ring.begin(), state.ring.end(), 0.f);
+            state.head = 0;
+        }
+        std::fill(pooledRing_.begin(), pooledRing_.end(), 0.f);
+        std::fill(pooledSum_.begin(), pooledSum_.end(), 0.f);
+        pooledHead_ = 0;
+        frames_ = 0;
+    }
+
+    // Input is [joint][channel] for the newest frame. The activations
+    // between blocks live in `scratch` only for the duration of the call.
+    const std::vector<float>& step(const float* input, FrameArena& scratch)
+    {
+        const FrameArenaScope scope(scratch);
+        Activations a;
+        a.aggregated = scratch.allocate_array<float>(kPartitions * kJoints * widest_);
+        a.current = scratch.allocate_array<float>(kJoints * widest_);
+        a.next = scratch.allocate_array<float>(kJoints * widest_);
+
+        const auto& blocks = model_->blocks();
+        std::copy(input, input + kJoints * model_->in_channels(), a.current);
+
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            run_block(blocks[b], states_[b], a);
+            std::swap(a.current, a.next);
+        }
+
+        update_pool(blocks.back().outChannels, a.current);
+        classify(blocks.back().outChannels);
+        frames_++;
+        return probabilities_;
+    }
+
+    const std::vector<float>& probabilities() const { return probabilities_; }
+    int frames() const { return frames_; }
+
+private:
+    struct BlockState
+    {
+        std::vector<float> ring; // [tap][joint][out]
+        int head{ 0 };
+    };
+
+    struct Activations
+    {
+        float* aggregated;  // [partition][joint][in]
+        float* current;     // [joint][in], the block's input
+        float* next;        // [joint][out], its output
+    };
+
+    void run_block(const Block& block, BlockState& state, const Activations& a)
+    {
+        const int in = block.inChannels;
+        const int out = block.outChannels;
+        const int kt = block.temporalKernel;
+
+        // Sparse aggregation per partition: agg[p][v] = sum_u A_p[v][u] * x[u].
+        for (int p = 0; p < kPartitions; p++)
+        {
+            float* agg = a.aggregated + p * kJoints * in;
+            for (int v = 0; v < kJoints; v++)
+            {
+                float* dst = agg + v * in;
+                std::fill(dst, dst + in, 0.f);
+                for (int k = kAdjacency.rowStart[p][v]; k < kAdjacency.rowStart[p][v + 1]; k++)
+                {
+                    const float w = kAdjacency.weight[p][k];
+                    const float* src = a.current + kAdjacency.col[p][k] * in;
+                    for (int c = 0; c < in; c++) { dst[c] += w * src[c]; }
+                }
+            }
+        }
+
+        // The weights are by far the biggest operand, so every loop below
+        // walks a weight row once and applies it to all joints while it is
+        // in cache, instead of streaming the whole matrix once per joint.
+        // Each output still sums its terms in the same order.
+
+        // Channel mixing into the newest ring slot, followed by ReLU.
+        state.head = (state.head + 1) % kt;
+        float* spatial = &state.ring[state.head * kJoints * out];
+        for (int v = 0; v < kJoints; v++)
+        {
+            std::copy(block.spatialBias.begin(), block.spatialBias.end(), spatial + v * out);
+        }
+        for (int p = 0; p < kPartitions; p++)
+        {
+            const float* agg = a.aggregated + p * kJoints * in;
+            const float* weight = &block.spatialWeight[p * in * out];
+            for (int ci = 0; ci < in; ci++)
+            {
+                mix_row(weight + ci * out, agg + ci, in, spatial, out);
+            }
+        }
+        relu(spatial, kJoints * out);
+
+        // Causal temporal conv over the ring, plus residual and ReLU.
+        for (int v = 0; v < kJoints; v++)
+        {
+            std::copy(block.temporalBias.begin(), block.temporalBias.end(), a.next + v * out);
+        }
+        for (int tap = 0; tap < kt; tap++)
+        {
+            const int slot = (state.head - tap + kt) % kt;
+            const float* src = &state.ring[slot * kJoints * out];
+            const float* weight = &block.temporalWeight[tap * out * out];
+            for (int ci = 0; ci < out; ci++)
+            {
+                mix_row(weight + ci * out, src + ci, out, a.next, out);
+            }
+        }
+        if (block.residualWeight.empty())
+        {
+            for (int i = 0; i < kJoints * out; i++) { a.next[i] += a.current[i]; }
+        }
+        else
+        {
+            for (int v = 0; v < kJoints; v++)
+            {
+                float* dst = a.next + v * out;
+                for (int co = 0; co < out; co++) { dst[co] += block.residualBias[co]; }
+            }
+            for (int ci = 0; ci < in; ci++)
+            {
+                mix_row(&block.residualWeight[ci * out], a.current + ci, in, a.next, out);
+            }
+        }
+        relu(a.next, kJoints * out);
+    }
+
+    // dst[v][co] += src[v * srcStride] * row[co] for every joint v. The
+    // fixed-width groups vectorize at -O2 too, where a plain loop of
+    // unknown length stays scalar.
+    static void mix_row(const float* row, const float* src, int srcStride, float* dst, int out)
+    {
+        const int kGroup = 8;
+        for (int v = 0; v < kJoints; v++)
+        {
+            const float s = src[v * srcStride];
+            float* d = dst + v * out;
+            int co = 0;
+            for (; co + kGroup <= out; co += kGroup)
+            {
+                float sum[kGroup];
+                for (int k = 0; k < kGroup; k++) { sum[k] = d[co + k] + s * row[co + k]; }
+                for (int k = 0; k < kGroup; k++) { d[co + k] = sum[k]; }
+            }
+            for (; co < out; co++) { d[co] += s * row[co]; }
+        }
+    }
+
+    static void relu(float* values, int count)
+    {
+        for (int i = 0; i < count; i++) { values[i] = std::max(values[i], 0.f); }
+    }
+
+    void update_pool(int channels, const float* activation)
+    {
+        // Joint average of the newest frame replaces the oldest in the window.
+        float* slot = &pooledRing_[pooledHead_ * channels];
+        for (int c = 0; c < channels; c++) { pooledSum_[c] -= slot[c]; }
+        std::fill(slot, slot + channels, 0.f);
+        for (int v = 0; v < kJoints; v++)
+        {
+            const float* src = activation + v * channels;
+            for (int c = 0; c < channels; c++) { slot[c] += src[c]; }
+        }
+        for (int c = 0; c < channels; c++)
+        {
+            slot[c] *= 1.f / kJoints;
+            pooledSum_[c] += slot[c];
+        }
+        pooledHead_ = (pooledHead_ + 1) % model_->pool_window();
+    }
+
+    void classify(int channels)
+    {
+        const int classes = model_->class_count();
+        const float invWindow = 1.f / std::min(frames_ + 1, model_->pool_window());
+        const auto& weight = model_->fc_weight();
+
+        std::copy(model_->fc_bias().begin(), model_->fc_bias().end(), probabilities_.begin());
+        for (int c = 0; c < channels; c++)
+        {
+            const float s = pooledSum_[c] * invWindow;
+            const float* row = &weight[c * classes];
+            for (int k = 0; k < classes; k++) { probabilities_[k] += s * row[k]; }
+        }
+
+        const float peak = *std::max_element(probabilities_.begin(), probabilities_.end());
+        float total = 0.f;
+        for (auto& p : probabilities_)
+        {
+            p = std::exp(p - peak);
+            total += p;
+        }
+        for (auto& p : probabilities_) { p /= total; }
+    }
+
+    const Model* model_;
+    std::vector<BlockState> states_;
+    int widest_{ 0 };   // channels of the widest layer, for the scratch
+    std::vector<float> pooledRing_;
+    std::vector<float> pooledSum_;
+    int pooledHead_{ 0 };
+    int frames_{ 0 };
+    std::vector<float> probabilities_;
+};
+
+// Builds the model input for one body: world positions relative to the base
+// spine, in metres; untracked joints are zero.
+inline void body_to_input(const astra_body_t& body, float* input, int channels)
+{
+    const astra_vector3f_t& root = body.joints[ASTRA_JOINT_BASE_SPINE].worldPosition;
+    for (int v = 0; v < kJoints; v++)
+    {
+        float* dst = input + v * channels;
+        std::fill(dst, dst + channels, 0.f);
+        const astra_joint_t& joint = body.joints[v];
+        if (joint.status == ASTRA_JOINT_STATUS_NOT_TRACKED) { continue; }
+        dst[0] = (joint.worldPosition.x - root.x) * 0.001f;
+        if (channels > 1) { dst[1] = (joint.worldPosition.y - root.y) * 0.001f; }
+        if (channels > 2) { dst[2] = (joint.worldPosition.z - root.z) * 0.001f; }
+    }
+}
+
+// Keeps one Stream per tracked body id and steps them in parallel.
+class Runtime
+{
+public:
+    Runtime() = default;
+    Runtime(const Runtime&) = delete;
+    Runtime& operator=(const Runtime&) = delete;
+
+    bool load(const char* path)
+    {
+        if (!ownModel_.load(path)) { return false; }
+        attach(ownModel_);
+        return true;
+    }
+
+    // Uses a model loaded elsewhere, e.g. one shared by many runtimes. It
+    // must outlive this runtime.
+    void attach(const Model& model)
+    {
+        model_ = &model;
+        for (auto& slot : slots_)
+        {
+            slot.id = ASTRA_INVALID_BODY_ID;
+            slot.stream.reset(new Stream(*model_));
+        }
+        input_.assign(ASTRA_MAX_BODIES * kJoints * model_->in_channels(), 0.f);
+    }
+
+    // Steps all bodies on the calling thread, for callers that already
+    // keep every core busy.
+    void set_parallel(bool parallel)
+    {
+        parallel_ = parallel;
+    }
+
+    bool is_loaded() const { return model_->is_loaded(); }
+    int class_count() const { return model_->class_count(); }
+
+    // Steps every body once; slotOut receives the slot used for each body
+    // (same order as `bodies`), to be passed to probabilities(). Scratch
+    // comes from the arena of whichever band steps the body.
+    void step(const astra_body_t* const* bodies, int count, int* slotOut, FrameArenas& arenas)
+    {
+        if (!is_loaded()) { return; }
+
+        const int channels = model_->in_channels();
+
+        // Release slots of bodies that left before handing out new ones.
+        for (auto& slot : slots_)
+        {
+            slot.active = false;
+            for (int i = 0; i < count; i++)
+            {
+                slot.active = slot.active || slot.id == bodies[i]->id;
+            }
+            if (!slot.active) { slot.id = ASTRA_INVALID_BODY_ID; }
+        }
+        for (int i = 0; i < count; i++)
+        {
+            const int s = slot_for(bodies[i]->id);
+            slotOut[i] = s;
+            body_to_input(*bodies[i], &input_[s * kJoints * channels], channels);
+        }
+
+        // Bodies are spread over persistent workers, the calling thread
+        // included; the lambda is small enough that std::function keeps
+        // it without allocating.
+        arenas_ = &arenas;
+        const auto stepBodies = [this, slotOut](int begin, int end, int band) {
+            const int channels = model_->in_channels();
+            FrameArena& scratch = arenas_->band(band);
+            for (int i = begin; i < end; i++)
+            {
+                const int s = slotOut[i];
+                slots_[s].stream->step(&input_[s * kJoints * channels], scratch);
+            }
+        };
+        if (!parallel_ || count < 2)
+        {
+            stepBodies(0, count, 0);
+            return;
+        }
+        if (!bands_)
+        {
+            const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            bands_.reset(new ParallelBands(std::min(cores, static_cast<int>(ASTRA_MAX_BODIES)) - 1));
+        }
+        arenas.ensure_bands(bands_->band_count());
+        bands_->run(count, stepBodies, 1);
+    }
+
+    // Slot of a body stepped before, or -1.
+    int find_slot(astra_body_id_t id) const
+    {
+        for (int s = 0; s < ASTRA_MAX_BODIES; s++)
+        {
+            if (slots_[s].id == id) { return s; }
+        }
+        return -1;
+    }
+
+    const std::vector<float>& probabilities(int slot) const
+    {
+        return slots_[slot].stream->probabilities();
+    }
+
+private:
+    struct Slot
+    {
+        astra_body_id_t id{ ASTRA_INVALID_BODY_ID };
+        bool active{ false };
+        std::unique_ptr<Stream> stream;
+    };
+
+    int slot_for(astra_body_id_t id)
+    {
+        int freeSlot = -1;
+        for (int s = 0; s < ASTRA_MAX_BODIES; s++)
+        {
+            if (slots_[s].id == id) { return s; }
+            if (slots_[s].id == ASTRA_INVALID_BODY_ID && freeSlot < 0) { freeSlot = s; }
+        }
+        // At most ASTRA_MAX_BODIES bodies per frame, so a free slot exists.
+        slots_[freeSlot].id = id;
+        slots_[freeSlot].stream->reset();
+        return freeSlot;
+    }
+
+    Model ownModel_;
+    const Model* model_{ &ownModel_ };
+    bool parallel_{ true };
+    std::unique_ptr<ParallelBands> bands_;   // created on the first parallel step
+    FrameArenas* arenas_{ nullptr };         // those of the step in progress
+    Slot slots_[ASTRA_MAX_BODIES];
+    std::vector<float> input_;
+};
+
+} // namespace stgcn
+
+#endif /* STGCN_HPP */
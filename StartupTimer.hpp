@@ -0,0 +1,84 @@
+#ifndef STARTUPTIMER_HPP
+#define STARTUPTIMER_HPP
+
+#include "FrameClock.hpp"
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+// When each part of startup finished, counted from process launch as the
+// kernel recorded it, so loading the shared libraries before main() is
+// included. mark() may be called from any thread.
+class StartupTimer
+{
+public:
+    StartupTimer()
+        : launch_(frame_clock_now() - process_age())
+    {}
+
+    void mark(const char* step)
+    {
+        const FrameTime now = frame_clock_now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == kMaxSteps) { return; }
+        steps_[count_++] = Step{ step, now - launch_ };
+    }
+
+    FrameTime since_launch() const { return frame_clock_now() - launch_; }
+
+    void print_report() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < count_; i++)
+        {
+            printf("Startup: %-16s %7.1f ms\n", steps_[i].name, steps_[i].time / 1e6);
+        }
+    }
+
+private:
+    static const int kMaxSteps = 24;
+
+    struct Step
+    {
+        const char* name;
+        FrameTime time;
+    };
+
+    // Time since the process started, from its start time in clock ticks
+    // after boot; 0 if /proc can't tell.
+    static FrameTime process_age()
+    {
+        FILE* fp = fopen("/proc/self/stat", "r");
+        if (fp == nullptr) { return 0; }
+        char buffer[1024];
+        const size_t n = fread(buffer, 1, sizeof(buffer) - 1, fp);
+        fclose(fp);
+        buffer[n] = '\0';
+
+        // Field 22; the command name in field 2 may hold spaces, so count
+        // from the closing parenthesis.
+        const char* p = strrchr(buffer, ')');
+        unsigned long long startTicks = 0;
+        if (p == nullptr ||
+            sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+                   &startTicks) != 1)
+        {
+            return 0;
+        }
+
+        timespec boot;
+        clock_gettime(CLOCK_BOOTTIME, &boot);
+        const FrameTime sinceBoot = boot.tv_sec * 1000000000LL + boot.tv_nsec;
+        const FrameTime started = static_cast<FrameTime>(startTicks * 1000000000ULL / sysconf(_SC_CLK_TCK));
+        return sinceBoot > started ? sinceBoot - started : 0;
+    }
+
+    FrameTime launch_;
+    mutable std::mutex mutex_;
+    Step steps_[kMaxSteps];
+    int count_{ 0 };
+};
+
+#endif /* STARTUPTIMER_HPP */
@@ -0,0 +1,483 @@
+#ifndef SYNTHETICSCENE_HPP
+#define SYNTHETICSCENE_HPP
+
+#include "FrameClock.hpp"
+#include "FrameViews.hpp"
+#include "ParallelBands.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Depth frames and matching ground-truth skeletons of scripted people,
+// for exercising the fall and follow logic without a camera.
+//
+// People are capsules (head, neck, torso, limbs) hung on the 19 Astra
+// joints, posed from a script: walking, sitting down, falling or lying.
+// render() ray-casts them against a floor and a back wall in row bands
+// on ParallelBands, then adds what the structured-light sensor does to
+// real depth: noise growing with z^2, projector shadows to the left of
+// near edges, random dropouts and nothing past the maximum range. The
+// body list carries the exact joints, the body mask marks the nearest
+// person per pixel and the floor plane is known.
+//
+// Coordinates follow the SDK's world space: mm, camera at the origin,
+// +X right, +Y up, +Z forward; the floor is y = -cameraHeight.
+
+enum SceneMotion
+{
+    MOTION_STANDING,
+    MOTION_WALKING,   // paces left and right of x along the image
+    MOTION_SITTING,   // stands, then sits down at eventTime
+    MOTION_FALLING,   // walks, then falls over at eventTime and stays down
+    MOTION_LYING,     // on the floor throughout
+};
+
+struct ScenePerson
+{
+    SceneMotion motion{ MOTION_STANDING };
+    float x{ 0.f };                  // mm, position on the floor
+    float z{ 2500.f };
+    float walkRange{ 1500.f };       // mm, full width of the pacing
+    float walkSpeed{ 800.f };        // mm/s
+    float fallDirection{ 0.f };      // rad; 0 falls to +X, pi/2 away from the camera
+    FrameTime eventTime{ 2000000000LL };
+    float height{ 1700.f };          // mm, scales the whole body
+};
+
+// Standing pose of a 1700 mm person relative to the floor under the base
+// spine, in joint type order: x lateral, y height. The tools that need a
+// plausible skeleton without rendering a scene pose it from this too.
+const float kStandingPose[ASTRA_MAX_JOINTS][2] = {
+    { 0, 1600 }, { 0, 1400 }, { -180, 1400 }, { -220, 1120 }, { -230, 820 },
+    { 180, 1400 }, { 220, 1120 }, { 230, 820 }, { 0, 1180 }, { 0, 950 },
+    { -100, 920 }, { -110, 500 }, { -110, 80 }, { 100, 920 }, { 110, 500 },
+    { 110, 80 }, { -230, 880 }, { 230, 880 }, { 0, 1500 },
+};
+
+class SyntheticScene
+{
+public:
+    SyntheticScene(int width = 320, int height = 240,
+                   int threads = std::max(1u, std::thread::hardware_concurrency()) - 1)
+        : width_(width),
+          height_(height),
+          bands_(threads),
+          depth_(width * height),
+          background_(width * height),
+          bodyMask_(width * height),
+          floorMask_(width * height),
+          backgroundFloor_(width * height),
+          rowScratch_(bands_.band_count())
+    {
+        std::memset(&bodies_, 0, sizeof(bodies_));
+        update_camera();
+    }
+
+    // Nominal Astra depth field of view, in radians.
+    void set_field_of_view(float horizontal, float vertical)
+    {
+        hfov_ = horizontal;
+        vfov_ = vertical;
+        update_camera();
+    }
+
+    void set_camera_height(float mm)
+    {
+        cameraHeight_ = mm;
+        update_camera();
+    }
+
+    void set_wall_distance(float mm)
+    {
+        wallDistance_ = mm;
+        update_camera();
+    }
+
+    // Off gives clean depth, for checking geometry.
+    void set_sensor_effects(bool enabled) { sensorEffects_ = enabled; }
+
+    // Returns the body id; at most ASTRA_MAX_BODIES people.
+    int add_person(const ScenePerson& person)
+    {
+        if (people_.size() == ASTRA_MAX_BODIES) { return 0; }
+        people_.push_back(person);
+        return static_cast<int>(people_.size());
+    }
+
+    int person_count() const { return static_cast<int>(people_.size()); }
+
+    // Ground truth: whether person i is down (lying, or more than halfway
+    // through a fall) at the last rendered time.
+    bool is_down(int i) const { return down_[i]; }
+
+    void render(FrameTime time)
+    {
+        frameIndex_++;
+        const double t = frame_time_seconds(time);
+        capsules_.clear();
+        for (size_t i = 0; i < people_.size(); i++)
+        {
+            astra_body_t& body = bodies_.bodies[i];
+            pose(people_[i], t, body, down_[i]);
+            body.id = static_cast<astra_body_id_t>(i + 1);
+            add_capsules(body, static_cast<uint8_t>(i + 1), people_[i].height / 1700.f);
+        }
+        bodies_.count = static_cast<int32_t>(people_.size());
+
+        bands_.run(height_, [this](int rowBegin, int rowEnd, int band) {
+            render_rows(rowBegin, rowEnd, band);
+        });
+    }
+
+    DepthView depth() const
+    {
+        DepthView view;
+        view.data = depth_.data();
+        view.width = width_;
+        view.height = height_;
+        view.frameIndex = frameIndex_;
+        return view;
+    }
+
+    BodyFrameView bodies() const
+    {
+        BodyFrameView view;
+        view.valid = true;
+        view.frameIndex = frameIndex_;
+        view.width = width_;
+        view.height = height_;
+        view.bodies = bodies_.bodies;
+        view.count = bodies_.count;
+        view.floorPlane = { 0.f, 1.f, 0.f, cameraHeight_ };
+        view.floorDetected = true;
+        view.bodyMask = bodyMask_.data();
+        view.floorMask = floorMask_.data();
+        view.maskWidth = width_;
+        view.maskHeight = height_;
+        return view;
+    }
+
+private:
+    struct Capsule
+    {
+        astra_vector3f_t a;
+        astra_vector3f_t b;
+        float radius;
+        uint8_t bodyId;
+        int left, top, right, bottom;   // pixel bounds
+    };
+
+    struct Bone
+    {
+        int from;
+        int to;
+        float radius;   // mm for a 1700 mm person
+    };
+
+    static void pose(const ScenePerson& person, double t, astra_body_t& body, bool& down)
+    {
+        const auto& standing = kStandingPose;
+        const float scale = person.height / 1700.f;
+        const double event = frame_time_seconds(person.eventTime);
+
+        float x = person.x;
+        float stride = 0.f;
+        if (person.motion == MOTION_WALKING || person.motion == MOTION_FALLING)
+        {
+            // A faller stops where the fall starts.
+            const double walked = person.motion == MOTION_FALLING ? std::min(t, event) : t;
+            const float half = 0.5f * person.walkRange;
+            x += half * static_cast<float>(std::sin(walked * person.walkSpeed / std::max(half, 1.f)));
+            stride = t == walked ? static_cast<float>(std::sin(t * 6.0)) : 0.f;
+        }
+
+        // How far the body has tipped over (0 upright, 1 flat) and how far
+        // it has sat down.
+        float tip = 0.f;
+        float sit = 0.f;
+        if (person.motion == MOTION_LYING)
+        {
+            tip = 1.f;
+        }
+        else if (person.motion == MOTION_FALLING && t >= event)
+        {
+            const float u = std::min(1.f, static_cast<float>((t - event) / 0.8));
+            tip = u * u;   // accelerates like a fall
+        }
+        else if (person.motion == MOTION_SITTING && t >= event)
+        {
+            sit = std::min(1.f, static_cast<float>(t - event));
+        }
+        down = tip > 0.5f;
+
+        const float theta = tip * 1.5708f;
+        const float dx = std::cos(person.fallDirection);
+        const float dz = std::sin(person.fallDirection);
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            float lx = standing[j][0] * scale;
+            float ly = standing[j][1] * scale;
+            float lz = 0.f;
+
+            const bool leftLeg = j == ASTRA_JOINT_LEFT_KNEE || j == ASTRA_JOINT_LEFT_FOOT;
+            const bool rightLeg = j == ASTRA_JOINT_RIGHT_KNEE || j == ASTRA_JOINT_RIGHT_FOOT;
+            const bool leftArm = j == ASTRA_JOINT_LEFT_WRIST || j == ASTRA_JOINT_LEFT_HAND;
+            const bool rightArm = j == ASTRA_JOINT_RIGHT_WRIST || j == ASTRA_JOINT_RIGHT_HAND;
+            const float swing = (j == ASTRA_JOINT_LEFT_FOOT || j == ASTRA_JOINT_RIGHT_FOOT) ? 250.f : 120.f;
+            if (leftLeg || rightArm) { lz += stride * swing * scale; }
+            if (rightLeg || leftArm) { lz -= stride * swing * scale; }
+
+            if (sit > 0.f)
+            {
+                // Hips drop to chair height, thighs come forward (towards
+                // the camera), shins stay vertical.
+                const float hipDrop = 470.f * scale * sit;
+                if (j == ASTRA_JOINT_LEFT_KNEE || j == ASTRA_JOINT_RIGHT_KNEE)
+                {
+                    lz -= 420.f * scale * sit;
+                }
+                else if (j == ASTRA_JOINT_LEFT_FOOT || j == ASTRA_JOINT_RIGHT_FOOT)
+                {
+                    lz -= 420.f * scale * sit;
+                }
+                else
+                {
+                    ly -= hipDrop;
+                }
+            }
+
+            // Tip over about the feet; the body ends up resting on its
+            // back, 120 mm thick.
+            const float along = ly * std::sin(theta);
+            const float rest = 120.f * scale * tip;
+            ly = ly * std::cos(theta) + rest;
+
+            astra_joint_t& joint = body.joints[j];
+            joint.type = static_cast<astra_joint_type_t>(j);
+            joint.worldPosition = { x + lx + along * dx, ly, person.z + lz + along * dz };
+        }
+    }
+
+    void add_capsules(astra_body_t& body, uint8_t bodyId, float scale)
+    {
+        static const Bone bones[] = {
+            { ASTRA_JOINT_HEAD, ASTRA_JOINT_HEAD, 105.f },
+            { ASTRA_JOINT_NECK, ASTRA_JOINT_SHOULDER_SPINE, 60.f },
+            { ASTRA_JOINT_SHOULDER_SPINE, ASTRA_JOINT_BASE_SPINE, 150.f },
+            { ASTRA_JOINT_LEFT_SHOULDER, ASTRA_JOINT_RIGHT_SHOULDER, 60.f },
+            { ASTRA_JOINT_LEFT_HIP, ASTRA_JOINT_RIGHT_HIP, 90.f },
+            { ASTRA_JOINT_LEFT_SHOULDER, ASTRA_JOINT_LEFT_ELBOW, 50.f },
+            { ASTRA_JOINT_LEFT_ELBOW, ASTRA_JOINT_LEFT_WRIST, 40.f },
+            { ASTRA_JOINT_LEFT_WRIST, ASTRA_JOINT_LEFT_HAND, 40.f },
+            { ASTRA_JOINT_RIGHT_SHOULDER, ASTRA_JOINT_RIGHT_ELBOW, 50.f },
+            { ASTRA_JOINT_RIGHT_ELBOW, ASTRA_JOINT_RIGHT_WRIST, 40.f },
+            { ASTRA_JOINT_RIGHT_WRIST, ASTRA_JOINT_RIGHT_HAND, 40.f },
+            { ASTRA_JOINT_LEFT_HIP, ASTRA_JOINT_LEFT_KNEE, 75.f },
+            { ASTRA_JOINT_LEFT_KNEE, ASTRA_JOINT_LEFT_FOOT, 55.f },
+            { ASTRA_JOINT_RIGHT_HIP, ASTRA_JOINT_RIGHT_KNEE, 75.f },
+            { ASTRA_JOINT_RIGHT_KNEE, ASTRA_JOINT_RIGHT_FOOT, 55.f },
+        };
+
+        // Joints are relative to the floor so far; move them into camera
+        // space and fill in what the SDK would report.
+        astra_vector3f_t sum = { 0.f, 0.f, 0.f };
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            astra_joint_t& joint = body.joints[j];
+            joint.worldPosition.y -= cameraHeight_;
+            const astra_vector3f_t& p = joint.worldPosition;
+            joint.depthPosition = { cx_ + p.x / p.z * fx_, cy_ - p.y / p.z * fy_ };
+            const bool inView = p.z > 0.f && joint.depthPosition.x >= 0.f && joint.depthPosition.x < width_ &&
+                                joint.depthPosition.y >= 0.f && joint.depthPosition.y < height_;
+            joint.status = inView ? ASTRA_JOINT_STATUS_TRACKED : ASTRA_JOINT_STATUS_NOT_TRACKED;
+            sum.x += p.x;
+            sum.y += p.y;
+            sum.z += p.z;
+        }
+        body.status = ASTRA_BODY_STATUS_TRACKING;
+        body.features = ASTRA_BODY_TRACKING_JOINTS;
+        body.centerOfMass = { sum.x / ASTRA_MAX_JOINTS, sum.y / ASTRA_MAX_JOINTS, sum.z / ASTRA_MAX_JOINTS };
+
+        for (const Bone& bone : bones)
+        {
+            Capsule c;
+            c.a = body.joints[bone.from].worldPosition;
+            c.b = body.joints[bone.to].worldPosition;
+            c.radius = bone.radius * scale;
+            if (bone.from == bone.to) { c.b.y -= 1.f; }   // a sphere
+            c.bodyId = bodyId;
+
+            // Screen bounds of the two end spheres.
+            const float zNear = std::min(c.a.z, c.b.z) - c.radius;
+            if (zNear < 100.f) { continue; }
+            const float rx = c.radius / zNear * fx_;
+            const float ry = c.radius / zNear * fy_;
+            const float ax = cx_ + c.a.x / c.a.z * fx_, bx = cx_ + c.b.x / c.b.z * fx_;
+            const float ay = cy_ - c.a.y / c.a.z * fy_, by = cy_ - c.b.y / c.b.z * fy_;
+            c.left = std::max(0, static_cast<int>(std::min(ax, bx) - rx) - 1);
+            c.right = std::min(width_, static_cast<int>(std::max(ax, bx) + rx) + 2);
+            c.top = std::max(0, static_cast<int>(std::min(ay, by) - ry) - 1);
+            c.bottom = std::min(height_, static_cast<int>(std::max(ay, by) + ry) + 2);
+            if (c.left < c.right && c.top < c.bottom) { capsules_.push_back(c); }
+        }
+    }
+
+    // Ray from the origin along unit `d` against a capsule; the distance
+    // along the ray, or -1 on a miss.
+    static float intersect(const float d[3], const Capsule& c)
+    {
+        const float ba[3] = { c.b.x - c.a.x, c.b.y - c.a.y, c.b.z - c.a.z };
+        const float oa[3] = { -c.a.x, -c.a.y, -c.a.z };
+        const float baba = ba[0] * ba[0] + ba[1] * ba[1] + ba[2] * ba[2];
+        const float bard = ba[0] * d[0] + ba[1] * d[1] + ba[2] * d[2];
+        const float baoa = ba[0] * oa[0] + ba[1] * oa[1] + ba[2] * oa[2];
+        const float rdoa = d[0] * oa[0] + d[1] * oa[1] + d[2] * oa[2];
+        const float oaoa = oa[0] * oa[0] + oa[1] * oa[1] + oa[2] * oa[2];
+        const float r2 = c.radius * c.radius;
+
+        const float a = baba - bard * bard;
+        float b = baba * rdoa - baoa * bard;
+        float cc = baba * oaoa - baoa * baoa - r2 * baba;
+        float h = b * b - a * cc;
+        if (h < 0.f) { return -1.f; }
+
+        const float t = (-b - std::sqrt(h)) / a;
+        const float y = baoa + t * bard;
+        if (y > 0.f && y < baba) { return t; }
+
+        // One of the end caps.
+        const float oc[3] = { y <= 0.f ? oa[0] : -c.b.x, y <= 0.f ? oa[1] : -c.b.y, y <= 0.f ? oa[2] : -c.b.z };
+        b = d[0] * oc[0] + d[1] * oc[1] + d[2] * oc[2];
+        cc = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - r2;
+        h = b * b - cc;
+        return h > 0.f ? -b - std::sqrt(h) : -1.f;
+    }
+
+    void update_camera()
+    {
+        fx_ = 0.5f * width_ / std::tan(0.5f * hfov_);
+        fy_ = 0.5f * height_ / std::tan(0.5f * vfov_);
+        cx_ = 0.5f * width_;
+        cy_ = 0.5f * height_;
+
+        // The empty room: floor below the horizon, wall behind.
+        for (int py = 0; py < height_; py++)
+        {
+            const float dy = (cy_ - py - 0.5f) / fy_;
+            const float floorZ = dy < 0.f ? cameraHeight_ / -dy : wallDistance_ + 1.f;
+            for (int px = 0; px < width_; px++)
+            {
+                const int i = py * width_ + px;
+                backgroundFloor_[i] = floorZ < wallDistance_ ? 1 : 0;
+                background_[i] = std::min(floorZ, wallDistance_);
+            }
+        }
+    }
+
+    // xorshift32, one stream per band and frame so bands don't share state.
+    static uint32_t next_random(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    void render_rows(int rowBegin, int rowEnd, int band)
+    {
+        uint32_t random = (frameIndex_ * 2654435761u) ^ (band * 40503u + 1u);
+        std::vector<float>& z = rowScratch_[band];
+        z.resize(width_);
+
+        for (int py = rowBegin; py < rowEnd; py++)
+        {
+            const int row = py * width_;
+            std::copy(background_.begin() + row, background_.begin() + row + width_, z.begin());
+            std::copy(backgroundFloor_.begin() + row, backgroundFloor_.begin() + row + width_, floorMask_.begin() + row);
+            std::fill(bodyMask_.begin() + row, bodyMask_.begin() + row + width_, 0);
+
+            const float dy = (cy_ - py - 0.5f) / fy_;
+            for (const Capsule& c : capsules_)
+            {
+                if (py < c.top || py >= c.bottom) { continue; }
+                for (int px = c.left; px < c.right; px++)
+                {
+                    const float dx = (px + 0.5f - cx_) / fx_;
+                    const float inv = 1.f / std::sqrt(dx * dx + dy * dy + 1.f);
+                    const float d[3] = { dx * inv, dy * inv, inv };
+                    const float t = intersect(d, c);
+                    const float hitZ = t * inv;
+                    if (t > 0.f && hitZ < z[px])
+                    {
+                        z[px] = hitZ;
+                        bodyMask_[row + px] = c.bodyId;
+                        floorMask_[row + px] = 0;
+                    }
+                }
+            }
+
+            int16_t* out = depth_.data() + row;
+            if (!sensorEffects_)
+            {
+                for (int px = 0; px < width_; px++) { out[px] = static_cast<int16_t>(z[px] + 0.5f); }
+                continue;
+            }
+
+            for (int px = 0; px < width_; px++)
+            {
+                // Noise grows with z^2; the sum of two uniforms is close
+                // enough to a gaussian.
+                const float sigma = 1.5e-6f * z[px] * z[px];
+                const float u = ((next_random(random) & 0xffff) + (next_random(random) & 0xffff)) / 65536.f - 1.f;
+                const float noisy = z[px] + u * 2.45f * sigma;
+                const bool dropout = (next_random(random) & 1023) < 2;
+                out[px] = noisy > kMaxRange || dropout ? 0 : static_cast<int16_t>(noisy + 0.5f);
+            }
+
+            // The projector sits to the right of the camera, so background
+            // just left of a near edge gets no pattern.
+            for (int px = 1; px < width_; px++)
+            {
+                const float near = z[px];
+                const float far = z[px - 1];
+                if (far - near < 200.f) { continue; }
+                const int shadow = static_cast<int>(fx_ * kBaseline * (1.f / near - 1.f / far));
+                for (int s = px - 1; s >= std::max(0, px - shadow); s--)
+                {
+                    if (z[s] > near + 100.f) { out[s] = 0; }
+                }
+            }
+        }
+    }
+
+    static constexpr float kBaseline = 75.f;     // mm between camera and projector
+    static constexpr float kMaxRange = 8000.f;   // mm
+
+    int width_;
+    int height_;
+    float hfov_{ 1.0472f };   // 60 degrees
+    float vfov_{ 0.8639f };   // 49.5 degrees
+    float cameraHeight_{ 600.f };
+    float wallDistance_{ 6000.f };
+    bool sensorEffects_{ true };
+    float fx_{ 0.f }, fy_{ 0.f }, cx_{ 0.f }, cy_{ 0.f };
+
+    ParallelBands bands_;
+    std::vector<ScenePerson> people_;
+    std::array<bool, ASTRA_MAX_BODIES> down_{ {} };
+    std::vector<Capsule> capsules_;
+    astra_frame_index_t frameIndex_{ 0 };
+
+    std::vector<int16_t> depth_;
+    std::vector<float> background_;
+    std::vector<uint8_t> bodyMask_;
+    std::vector<uint8_t> floorMask_;
+    std::vector<uint8_t> backgroundFloor_;
+    std::vector<std::vector<float>> rowScratch_;   // per band
+    astra_body_list_t bodies_;
+};
+
+#endif /* SYNTHETICSCENE_HPP */
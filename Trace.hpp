@@ -0,0 +1,204 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "FrameClock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Timeline tracing of the processing stages, written as Chrome trace
+// JSON (chrome://tracing, ui.perfetto.dev).
+//
+//   void process()
+//   {
+//       TRACE_ZONE("process");
+//       ...
+//   }
+//
+// Build with -DDOG_TRACE to record; otherwise TRACE_ZONE and TRACE_THREAD
+// expand to nothing. A zone costs two steady-clock reads and a store into
+// a ring buffer owned by the calling thread, so threads never contend.
+// Each ring keeps the latest 65536 zones; trace_dump() can be called at
+// any time from any thread and writes what the rings hold. Zone names
+// must be string literals.
+
+namespace trace {
+
+struct Event
+{
+    const char* name;
+    FrameTime begin;
+    FrameTime duration;
+};
+
+// Written only by its thread; head_ is published with release so a
+// reader sees complete events up to it.
+class ThreadBuffer
+{
+public:
+    static const uint64_t kCapacity = 1u << 16;
+
+    explicit ThreadBuffer(int tid)
+        : events_(new Event[kCapacity]),
+          tid_(tid)
+    { }
+
+    void record(const char* name, FrameTime begin, FrameTime end)
+    {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        events_[head & (kCapacity - 1)] = { name, begin, end - begin };
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    void set_name(const char* name) { name_.store(name); }
+
+    // Copies the events recorded so far. Slots the writer may have been
+    // overwriting during the copy are left out.
+    void snapshot(std::vector<Event>& out) const
+    {
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        const uint64_t first = head > kCapacity ? head - kCapacity : 0;
+        const size_t start = out.size();
+        for (uint64_t i = first; i < head; i++)
+        {
+            out.push_back(events_[i & (kCapacity - 1)]);
+        }
+
+        const uint64_t now = head_.load(std::memory_order_acquire);
+        const uint64_t safe = now >= kCapacity ? now - kCapacity + 1 : 0;
+        if (safe > first)
+        {
+            const size_t stale = static_cast<size_t>(std::min(safe - first, head - first));
+            out.erase(out.begin() + start, out.begin() + start + stale);
+        }
+    }
+
+    int tid() const { return tid_; }
+    const char* name() const { return name_.load(); }
+
+private:
+    std::unique_ptr<Event[]> events_;
+    std::atomic<uint64_t> head_{ 0 };
+    std::atomic<const char*> name_{ nullptr };
+    int tid_;
+};
+
+// Every thread that ever recorded a zone. Buffers outlive their threads
+// so a dump still shows work done by threads that have finished.
+class Registry
+{
+public:
+    static Registry& instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    ThreadBuffer* add()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.emplace_back(new ThreadBuffer(static_cast<int>(buffers_.size()) + 1));
+        return buffers_.back().get();
+    }
+
+    bool dump(const char* path)
+    {
+        FILE* fp = fopen(path, "w");
+        if (fp == nullptr)
+        {
+            printf("Trace: can't write %s\n", path);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Event> events;
+        size_t total = 0;
+        fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto& buffer : buffers_)
+        {
+            if (buffer->name() != nullptr)
+            {
+                fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", buffer->tid(), buffer->name());
+                first = false;
+            }
+
+            events.clear();
+            buffer->snapshot(events);
+            for (const Event& e : events)
+            {
+                fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        first ? "" : ",\n", e.name, buffer->tid(), e.begin / 1e3, e.duration / 1e3);
+                first = false;
+            }
+            total += events.size();
+        }
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+        printf("Trace: wrote %zu zones to %s\n", total, path);
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+inline ThreadBuffer& local_buffer()
+{
+    thread_local ThreadBuffer* buffer = Registry::instance().add();
+    return *buffer;
+}
+
+class Zone
+{
+public:
+    explicit Zone(const char* name)
+        : buffer_(local_buffer()),
+          name_(name),
+          begin_(frame_clock_now())
+    { }
+
+    ~Zone()
+    {
+        buffer_.record(name_, begin_, frame_clock_now());
+    }
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    ThreadBuffer& buffer_;
+    const char* name_;
+    FrameTime begin_;
+};
+
+} // namespace trace
+
+#ifdef DOG_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) ::trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD(name) ::trace::local_buffer().set_name(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#endif
+
+// Writes the trace recorded so far; false if tracing is compiled out or
+// the file can't be written.
+inline bool trace_dump(const char* path)
+{
+#ifdef DOG_TRACE
+    return trace::Registry::instance().dump(path);
+#else
+    printf("Trace: built without DOG_TRACE, nothing to write to %s\n", path);
+    return false;
+#endif
+}
+
+#endif /* TRACE_HPP */
@@ -0,0 +1,327 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include "FrameClock.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Binary protocol between the dog and a remote analysis host.
+//
+// A TCP stream of packets, each a fixed header followed by its payload.
+// Structures go on the wire as they are in memory; both ends are
+// little-endian (aarch64 on the dog, x86-64 on the host) and the layouts
+// only use fixed-width fields. Every packet carries a sequence number and
+// the sender's clock at sending; replies echo both, so the sender can
+// measure round trips against its own clock without any clock sync.
+
+const uint32_t kPacketMagic = 0x50474f44; // "DOGP"
+const uint16_t kPacketVersion = 2;
+const uint32_t kMaxPacketPayload = 4u << 20;
+
+enum PacketType : uint16_t
+{
+    PACKET_FRAME = 1,       // dog -> host: FramePayload, skeletons, depth
+    PACKET_DECISION = 2,    // host -> dog: DecisionPayload
+};
+
+struct PacketHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t sequence;
+    uint32_t payloadBytes;
+    int64_t sentTime;       // sender's clock, ns
+};
+
+// Followed by skeletonBytes of SkeletonPacket and depthBytes of RVL-coded
+// depth.
+struct FramePayload
+{
+    int64_t frameTime;
+    uint32_t frameIndex;
+    uint16_t skeletonBytes;
+    uint8_t floorDetected;
+    uint8_t bodyCount;
+    float floorPlane[4];
+    uint16_t width;
+    uint16_t height;
+    uint32_t depthBytes;
+};
+
+struct DecisionPayload
+{
+    uint32_t frameSequence; // sequence of the frame this answers
+    uint32_t targetId;      // 0 when nobody is followed
+    int64_t echoTime;       // sentTime of that frame, sender's clock
+    int64_t serverTime;     // time the host spent on it, ns
+    float distance;
+    float lateral;
+    float linear;           // unused, 0; the dog's PursuitController
+    float angular;          // turns distance and lateral into the twist
+    uint8_t alarm;
+    uint8_t bodyCount;
+    uint16_t reserved;
+};
+
+inline bool set_nonblocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Small packets must not wait for Nagle.
+inline void set_low_latency(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Starts a non-blocking connect; the socket becomes writable once it
+// completes. Returns -1 if the host can't be resolved.
+inline int tcp_connect(const char* host, int port)
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, service, &hints, &result) != 0 || result == nullptr)
+    {
+        printf("Transport: can't resolve %s\n", host);
+        return -1;
+    }
+
+    int fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd >= 0)
+    {
+        set_nonblocking(fd);
+        set_low_latency(fd);
+        if (connect(fd, result->ai_addr, result->ai_addrlen) != 0 && errno != EINPROGRESS)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+inline int tcp_listen(const char* host, int port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) { return -1; }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1 ||
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(fd, 4) != 0)
+    {
+        printf("Transport: can't listen on %s:%d (%s)\n", host, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd);
+    return fd;
+}
+
+// One end of a packet stream on a non-blocking socket. Outgoing packets
+// are built straight into the send buffer and written as the socket
+// accepts them; incoming bytes are buffered until a whole packet is there.
+class PacketChannel
+{
+public:
+    explicit PacketChannel(size_t sendLimit = 2u << 20)
+        : sendLimit_(sendLimit)
+    {
+        send_.reserve(sendLimit);
+        receive_.reserve(64u << 10);
+    }
+
+    ~PacketChannel()
+    {
+        close();
+    }
+
+    PacketChannel(const PacketChannel&) = delete;
+    PacketChannel& operator=(const PacketChannel&) = delete;
+
+    void attach(int fd)
+    {
+        close();
+        fd_ = fd;
+    }
+
+    void close()
+    {
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        send_.clear();
+        sendHead_ = 0;
+        receive_.clear();
+        receiveHead_ = 0;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+    size_t pending_bytes() const { return send_.size() - sendHead_; }
+
+    // Starts a packet; false when `payloadBytes` would overrun the send
+    // limit, in which case nothing is queued.
+    bool begin_packet(PacketType type, uint32_t sequence, FrameTime sentTime, size_t payloadBytes)
+    {
+        if (!is_open() || pending_bytes() + sizeof(PacketHeader) + payloadBytes > sendLimit_)
+        {
+            return false;
+        }
+        compact(send_, sendHead_);
+        packetStart_ = send_.size();
+
+        PacketHeader header;
+        header.magic = kPacketMagic;
+        header.version = kPacketVersion;
+        header.type = type;
+        header.sequence = sequence;
+        header.payloadBytes = 0;
+        header.sentTime = sentTime;
+        append(&header, sizeof(header));
+        return true;
+    }
+
+    void append(const void* data, size_t bytes)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        send_.insert(send_.end(), p, p + bytes);
+    }
+
+    // Room for `bytes` more at the end of the packet, e.g. to encode into;
+    // shrink with end_packet(used).
+    uint8_t* append_space(size_t bytes)
+    {
+        send_.resize(send_.size() + bytes);
+        return send_.data() + send_.size() - bytes;
+    }
+
+    void end_packet(size_t unused = 0)
+    {
+        send_.resize(send_.size() - unused);
+        const uint32_t payloadBytes = static_cast<uint32_t>(send_.size() - packetStart_ - sizeof(PacketHeader));
+        std::memcpy(send_.data() + packetStart_ + offsetof(PacketHeader, payloadBytes),
+                    &payloadBytes, sizeof(payloadBytes));
+    }
+
+    // Writes as much as the socket takes; false if the connection failed.
+    bool flush()
+    {
+        while (is_open() && pending_bytes() > 0)
+        {
+            const ssize_t n = ::send(fd_, send_.data() + sendHead_, pending_bytes(), MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                sendHead_ += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { return true; }
+            return fail("send");
+        }
+        if (pending_bytes() == 0)
+        {
+            send_.clear();
+            sendHead_ = 0;
+        }
+        return is_open();
+    }
+
+    // Reads whatever has arrived; false if the connection closed or failed.
+    bool fill()
+    {
+        while (is_open())
+        {
+            compact(receive_, receiveHead_);
+            const size_t used = receive_.size();
+            receive_.resize(used + kReadChunk);
+            const ssize_t n = ::recv(fd_, receive_.data() + used, kReadChunk, 0);
+            receive_.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
+            if (n > 0) { continue; }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { return true; }
+            return fail(n == 0 ? nullptr : "recv");
+        }
+        return false;
+    }
+
+    // Next complete packet from what fill() has read. The payload stays
+    // valid until the next fill().
+    bool next_packet(PacketHeader& header, const uint8_t*& payload)
+    {
+        const size_t available = receive_.size() - receiveHead_;
+        if (available < sizeof(PacketHeader)) { return false; }
+
+        std::memcpy(&header, receive_.data() + receiveHead_, sizeof(header));
+        if (header.magic != kPacketMagic || header.version != kPacketVersion ||
+            header.payloadBytes > kMaxPacketPayload)
+        {
+            printf("Transport: bad packet header, dropping connection\n");
+            close();
+            return false;
+        }
+        if (available < sizeof(PacketHeader) + header.payloadBytes) { return false; }
+
+        payload = receive_.data() + receiveHead_ + sizeof(PacketHeader);
+        receiveHead_ += sizeof(PacketHeader) + header.payloadBytes;
+        return true;
+    }
+
+private:
+    static const size_t kReadChunk = 64u << 10;
+
+    // Drops consumed bytes once they make up half the buffer.
+    static void compact(std::vector<uint8_t>& buffer, size_t& head)
+    {
+        if (head == 0 || head < buffer.size() / 2) { return; }
+        buffer.erase(buffer.begin(), buffer.begin() + head);
+        head = 0;
+    }
+
+    bool fail(const char* what)
+    {
+        if (what != nullptr)
+        {
+            printf("Transport: %s failed (%s)\n", what, strerror(errno));
+        }
+        close();
+        return false;
+    }
+
+    int fd_{ -1 };
+    size_t sendLimit_;
+    std::vector<uint8_t> send_;
+    size_t sendHead_{ 0 };
+    size_t packetStart_{ 0 };
+    std::vector<uint8_t> receive_;
+    size_t receiveHead_{ 0 };
+};
+
+#endif /* TRANSPORT_HPP */
@@ -0,0 +1,173 @@
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fire-and-forget task pool with one queue per worker.
+//
+// Tasks submitted from outside are dealt round-robin across the queues;
+// tasks submitted by a worker go to its own queue. A worker takes the
+// newest task from its own queue and, when that is empty, steals the
+// oldest from the others before going to sleep. Short tasks of uneven
+// length (one robot's frame here, a frame with six bodies there) thus
+// spread over all cores without a shared queue to fight over.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(int threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        threads = std::max(threads, 1);
+        for (int i = 0; i < threads; i++)
+        {
+            queues_.emplace_back(new Queue);
+        }
+        for (int i = 0; i < threads; i++)
+        {
+            workers_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        stop();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Runs the tasks already queued and joins the workers; for owners
+    // that must tear down what the tasks use before the pool goes away.
+    // Nothing may be submitted afterwards.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_)
+        {
+            if (worker.joinable()) { worker.join(); }
+        }
+    }
+
+    int size() const { return static_cast<int>(workers_.size()); }
+    size_t steals() const { return steals_.load(); }
+
+    void submit(Task task)
+    {
+        const int self = worker_index();
+        const size_t q = self >= 0 ? static_cast<size_t>(self) : next_++ % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+            queues_[q]->tasks.push_back(std::move(task));
+        }
+        pending_++;
+
+        // Pairs with the sleepers_/pending_ check in worker_loop: one of
+        // the two sides always sees the other's update.
+        if (sleepers_.load() > 0)
+        {
+            { std::lock_guard<std::mutex> lock(sleepMutex_); }
+            wake_.notify_one();
+        }
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct Worker
+    {
+        const WorkStealingPool* pool;
+        int index;
+    };
+
+    static Worker& this_worker()
+    {
+        thread_local Worker worker = { nullptr, -1 };
+        return worker;
+    }
+
+    // Index of the calling thread among our workers, -1 for other threads.
+    int worker_index() const
+    {
+        return this_worker().pool == this ? this_worker().index : -1;
+    }
+
+    bool take(int self, Task& task)
+    {
+        {
+            Queue& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        const int n = size();
+        for (int k = 1; k < n; k++)
+        {
+            Queue& victim = *queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                steals_++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(int self)
+    {
+        this_worker() = { this, self };
+        Task task;
+        for (;;)
+        {
+            if (take(self, task))
+            {
+                pending_--;
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepers_++;
+            wake_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+            sleepers_--;
+            if (stopping_) { return; }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_{ 0 };
+    std::atomic<int> pending_{ 0 };
+    std::atomic<int> sleepers_{ 0 };
+    std::atomic<size_t> steals_{ 0 };
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stopping_{ false };
+};
+
+#endif /* WORKSTEALINGPOOL_HPP */
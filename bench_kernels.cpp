@@ -0,0 +1,306 @@
+// Micro-benchmarks for the per-frame kernels: the depth and mask views,
+// the lit depth shading from the SDK samples, image rotation, body
+// analysis, an ST-GCN step and skeleton packing, on synthetic frames at
+// 320x240, 640x480 and 1280x960. Needs only the SDK headers, not its libraries, so it
+// runs on any Linux box.
+//
+//   g++ -std=c++14 -O2 -I<sdk>/include bench_kernels.cpp -pthread
+//       -o bench_kernels
+//
+// Usage: bench_kernels [--seconds <s>] [--filter <name>]
+//
+// Each kernel runs for --seconds (default 0.5) per size after a short
+// warm-up. Reported are ns per pixel (per body for the body kernels),
+// frames per second and heap allocations per frame; run it before and
+// after a change to see what the change bought. The per-frame kernels must
+// not allocate once warmed up, so any case that does makes the exit
+// status 1.
+
+#define DOG_ALLOC_COUNT
+#include "AllocCounter.hpp"
+#include "BodyAnalysis.hpp"
+#include "FrameClock.hpp"
+#include "FrameKernels.hpp"
+#include "SkeletonPacket.hpp"
+#include "StGcn.hpp"
+#include "SyntheticScene.hpp"
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace {
+
+// A wall at 4 m, a floor, and a person-sized block at 2.5 m with a few
+// dropped-out pixels along its edges, like the sensor delivers.
+struct SyntheticFrame
+{
+    int width;
+    int height;
+    std::vector<int16_t> depth;
+    std::vector<astra::Vector3f> points;
+    std::vector<uint8_t> bodyMask;
+    std::vector<uint8_t> floorMask;
+
+    SyntheticFrame(int w, int h)
+        : width(w), height(h), depth(w * h), points(w * h), bodyMask(w * h), floorMask(w * h)
+    {
+        const float focal = w * 0.9f;
+        srand(42);
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                const int i = y * w + x;
+                const bool person = x >= w * 2 / 5 && x < w * 3 / 5 && y >= h / 5 && y < h * 9 / 10;
+                const bool floor = !person && y >= h * 3 / 4;
+                int16_t z = person ? 2500 : floor ? static_cast<int16_t>(1500 + 2500 * (h - y) * 4 / h) : 4000;
+                if ((x == w * 2 / 5 || x == w * 3 / 5) && rand() % 3 == 0) { z = 0; }
+
+                depth[i] = z;
+                bodyMask[i] = person ? 1 : 0;
+                floorMask[i] = floor ? 1 : 0;
+                points[i] = astra::Vector3f((x - w / 2) * z / focal, (h / 2 - y) * z / focal, z);
+            }
+        }
+    }
+};
+
+// Six people standing side by side, swaying a little from frame to frame.
+void standing_bodies(int frame, astra_body_list_t& list)
+{
+    std::memset(&list, 0, sizeof(list));
+    list.count = ASTRA_MAX_BODIES;
+    for (int b = 0; b < ASTRA_MAX_BODIES; b++)
+    {
+        astra_body_t& body = list.bodies[b];
+        const float x = (b - 2.5f) * 700.f + 50.f * std::sin(frame * 0.1f + b);
+        const float z = 3000.f + 200.f * b;
+        body.id = static_cast<astra_body_id_t>(b + 1);
+        body.status = ASTRA_BODY_STATUS_TRACKING;
+        body.features = ASTRA_BODY_TRACKING_JOINTS;
+        body.centerOfMass = { x, 100.f, z };
+        for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+        {
+            astra_joint_t& joint = body.joints[j];
+            joint.type = static_cast<astra_joint_type_t>(j);
+            joint.status = ASTRA_JOINT_STATUS_TRACKED;
+            const float height = kStandingPose[j][1] - kStandingPose[ASTRA_JOINT_BASE_SPINE][1];
+            joint.worldPosition = { x + kStandingPose[j][0], height, z };
+            joint.depthPosition = { 160.f + joint.worldPosition.x * 0.1f, 120.f - joint.worldPosition.y * 0.1f };
+        }
+    }
+}
+
+void write_u32(FILE* fp, uint32_t value)
+{
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+void write_tensor(FILE* fp, uint32_t count)
+{
+    const uint8_t type = 0;
+    fwrite(&type, 1, 1, fp);
+    write_u32(fp, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const float w = (rand() % 2001 - 1000) * 1e-4f;
+        fwrite(&w, sizeof(w), 1, fp);
+    }
+}
+
+// An untrained ST-GCN of the usual shape (9 blocks, 64 to 256 channels,
+// temporal kernel 9) with random weights, in the StGcn.hpp file format.
+bool write_synthetic_model(const char* path)
+{
+    FILE* fp = fopen(path, "wb");
+    if (fp == nullptr) { return false; }
+
+    const uint32_t widths[] = { 64, 64, 64, 128, 128, 128, 256, 256, 256 };
+    const uint32_t blocks = sizeof(widths) / sizeof(widths[0]);
+    const uint32_t kt = 9;
+    const uint32_t classes = ACTION_COUNT;
+    fwrite("STGC", 1, 4, fp);
+    for (uint32_t value : { 1u, static_cast<uint32_t>(ASTRA_MAX_JOINTS), 3u, classes, blocks, 30u })
+    {
+        write_u32(fp, value);
+    }
+
+    srand(7);
+    uint32_t in = 3;
+    for (uint32_t out : widths)
+    {
+        const uint32_t residual = in != out ? 1 : 0;
+        for (uint32_t value : { in, out, kt, residual }) { write_u32(fp, value); }
+        write_tensor(fp, stgcn::kPartitions * in * out);
+        write_tensor(fp, out);
+        write_tensor(fp, kt * out * out);
+        write_tensor(fp, out);
+        if (residual)
+        {
+            write_tensor(fp, in * out);
+            write_tensor(fp, out);
+        }
+        in = out;
+    }
+    write_tensor(fp, in * classes);
+    write_tensor(fp, classes);
+    return fclose(fp) == 0;
+}
+
+struct Options
+{
+    double seconds{ 0.5 };
+    const char* filter{ nullptr };
+    int allocatingCases{ 0 };
+};
+
+// Runs `kernel` repeatedly and prints one result line. `units` is what
+// one run processes (pixels or bodies) and `unitName` its label.
+// Allocations are counted process-wide, so work handed to other threads
+// is included.
+void measure(Options& options, const char* name, const char* size, double units, const char* unitName,
+             const std::function<void(int)>& kernel)
+{
+    if (options.filter != nullptr && strstr(name, options.filter) == nullptr) { return; }
+
+    for (int i = 0; i < 3; i++) { kernel(i); }
+
+    const uint64_t allocationsBefore = heap_allocations();
+    const FrameTime begin = frame_clock_now();
+    const FrameTime end = begin + static_cast<FrameTime>(options.seconds * 1e9);
+    int runs = 0;
+    FrameTime now = begin;
+    do
+    {
+        kernel(runs++);
+        now = frame_clock_now();
+    } while (now < end);
+
+    const double elapsed = static_cast<double>(now - begin);
+    const uint64_t allocations = heap_allocations() - allocationsBefore;
+    const double allocs = static_cast<double>(allocations) / runs;
+    printf("%-22s %-10s %9.3f ns/%-5s %10.1f frames/s %8.2f allocs/frame\n",
+           name, size, elapsed / runs / units, unitName, runs * 1e9 / elapsed, allocs);
+    if (heap_counting_enabled() && allocations > 0) { options.allocatingCases++; }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) { options.seconds = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) { options.filter = argv[++i]; }
+    }
+
+    const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+    for (const auto& wh : sizes)
+    {
+        const SyntheticFrame frame(wh[0], wh[1]);
+        const int pixels = frame.width * frame.height;
+        char size[16];
+        snprintf(size, sizeof(size), "%dx%d", frame.width, frame.height);
+
+        std::vector<uint8_t> rgba(pixels * 4);
+        std::vector<astra::Vector3f> normals(pixels);
+        std::vector<astra::Vector3f> blurred(pixels);
+        std::vector<int16_t> rotated(pixels);
+        const astra::Vector3f light(0.44022f, -0.17609f, 0.88045f);
+
+        measure(options, "depth_to_rgba", size, pixels, "px", [&](int) {
+            depth_to_rgba(frame.depth.data(), frame.width, frame.height, rgba.data());
+        });
+        measure(options, "masks_to_rgba", size, pixels, "px", [&](int) {
+            masks_to_rgba(frame.bodyMask.data(), frame.floorMask.data(), frame.width, frame.height, rgba.data());
+        });
+        measure(options, "lit_depth_normals", size, pixels, "px", [&](int) {
+            lit_depth_normals(frame.points.data(), frame.width, frame.height, normals.data());
+        });
+        measure(options, "box_blur_fast", size, pixels, "px", [&](int) {
+            box_blur_fast(normals.data(), blurred.data(), frame.width, frame.height);
+        });
+        measure(options, "lit_depth_shade", size, pixels, "px", [&](int) {
+            lit_depth_shade(frame.points.data(), blurred.data(), frame.width, frame.height, light, rgba.data());
+        });
+        measure(options, "lit_depth_update", size, pixels, "px", [&](int) {
+            lit_depth_normals(frame.points.data(), frame.width, frame.height, normals.data());
+            box_blur_fast(normals.data(), blurred.data(), frame.width, frame.height);
+            lit_depth_shade(frame.points.data(), blurred.data(), frame.width, frame.height, light, rgba.data());
+        });
+        measure(options, "rotate_image_90", size, pixels, "px", [&](int) {
+            rotate_image(reinterpret_cast<const uint8_t*>(frame.depth.data()), 2, frame.width, frame.height, 90,
+                         reinterpret_cast<uint8_t*>(rotated.data()));
+        });
+        measure(options, "rotate_image_180", size, pixels, "px", [&](int) {
+            rotate_image(reinterpret_cast<const uint8_t*>(frame.depth.data()), 2, frame.width, frame.height, 180,
+                         reinterpret_cast<uint8_t*>(rotated.data()));
+        });
+    }
+
+    // Body work doesn't depend on the image size.
+    std::vector<astra_body_list_t> lists(64);
+    for (size_t i = 0; i < lists.size(); i++)
+    {
+        standing_bodies(static_cast<int>(i), lists[i]);
+    }
+    const astra_plane_t floor = { 0.f, 1.f, 0.f, 1000.f };
+
+    BodyAnalyzer analyzer;
+    FrameArenas arenas;
+    measure(options, "body_analysis", "6 bodies", ASTRA_MAX_BODIES, "body", [&](int run) {
+        const astra_body_list_t& list = lists[run % lists.size()];
+        const astra_body_t* bodies[ASTRA_MAX_BODIES];
+        for (int b = 0; b < list.count; b++) { bodies[b] = &list.bodies[b]; }
+        arenas.reset();
+        analyzer.analyze(run * 33333333LL, bodies, list.count, floor, true, arenas);
+        analyzer.decide();
+    });
+
+    // Generated rather than shipped; only the cost matters here, not what
+    // the weights say.
+    char modelPath[] = "/tmp/bench_kernels-XXXXXX";
+    const int modelFd = mkstemp(modelPath);
+    stgcn::Model model;
+    const bool haveModel = modelFd >= 0 && write_synthetic_model(modelPath) && model.load(modelPath);
+    if (modelFd >= 0)
+    {
+        close(modelFd);
+        unlink(modelPath);
+    }
+    if (haveModel)
+    {
+        stgcn::Runtime runtime;
+        runtime.attach(model);
+        measure(options, "stgcn_step", "6 bodies", ASTRA_MAX_BODIES, "body", [&](int run) {
+            const astra_body_list_t& list = lists[run % lists.size()];
+            const astra_body_t* bodies[ASTRA_MAX_BODIES];
+            int slots[ASTRA_MAX_BODIES];
+            for (int b = 0; b < list.count; b++) { bodies[b] = &list.bodies[b]; }
+            arenas.reset();
+            runtime.step(bodies, list.count, slots, arenas);
+        });
+    }
+    else
+    {
+        printf("bench_kernels: could not generate an ST-GCN model, skipping stgcn_step\n");
+    }
+
+    SkeletonEncoder encoder;
+    uint8_t packet[kSkeletonPacketMaxBytes];
+    measure(options, "skeleton_encode", "6 bodies", ASTRA_MAX_BODIES, "body", [&](int run) {
+        const astra_body_list_t& list = lists[run % lists.size()];
+        encoder.encode(list.bodies, list.count, packet);
+    });
+
+    if (options.allocatingCases > 0)
+    {
+        printf("bench_kernels: %d case(s) allocated after warm-up\n", options.allocatingCases);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+// Load generator for ingest_server: emulates N dogs on one machine, each
+// with its own OffloadClient streaming a synthetic person walking around
+// in front of it, and reports how many decisions come back.
+//
+//   g++ -std=c++14 -O2 -I<sdk>/include ingest_loadgen.cpp -pthread
+//       -o ingest_loadgen
+//
+// Usage: ingest_loadgen [--host <address>] [--port <port>] [--robots <n>]
+//                       [--threads <n>] [--fps <f>] [--seconds <s>] [--depth]
+//
+// --fps 0 sends each frame as soon as the previous ones are answered
+// (within the client's in-flight window), which measures throughput;
+// a positive rate measures latency at that load. --depth sends depth
+// without skeletons, so the host has to run the depth-only tracker.
+//
+// To see how the host scales, run it with --workers 1, 2, 4, ... against
+// the same load, e.g. `ingest_loadgen --robots 32 --fps 0 --seconds 10`.
+
+#include "OffloadClient.hpp"
+#include "SyntheticScene.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A person pacing left and right 1.5-4 m in front of the dog.
+void walking_body(double t, int robot, astra_body_t& body)
+{
+    std::memset(&body, 0, sizeof(body));
+    const double phase = t * 0.4 + robot * 0.7;
+    const float x = static_cast<float>(1200.0 * std::sin(phase));
+    const float z = static_cast<float>(2750.0 + 1250.0 * std::cos(phase * 0.5));
+    const float stride = static_cast<float>(150.0 * std::sin(t * 6.0));
+
+    body.id = 1;
+    body.status = ASTRA_BODY_STATUS_TRACKING;
+    body.features = ASTRA_BODY_TRACKING_JOINTS;
+    body.centerOfMass = { x, 100.f, z };
+    for (int j = 0; j < ASTRA_MAX_JOINTS; j++)
+    {
+        astra_joint_t& joint = body.joints[j];
+        const bool left = j == ASTRA_JOINT_LEFT_KNEE || j == ASTRA_JOINT_LEFT_FOOT;
+        const bool right = j == ASTRA_JOINT_RIGHT_KNEE || j == ASTRA_JOINT_RIGHT_FOOT;
+        joint.type = static_cast<astra_joint_type_t>(j);
+        joint.status = ASTRA_JOINT_STATUS_TRACKED;
+        const float height = kStandingPose[j][1] - kStandingPose[ASTRA_JOINT_BASE_SPINE][1];
+        joint.worldPosition = { x + kStandingPose[j][0], height, z + (left ? stride : 0.f) - (right ? stride : 0.f) };
+    }
+}
+
+// A wall at 4 m with a person-sized block in front of it.
+void walking_depth(double t, std::vector<int16_t>& depth, int width, int height)
+{
+    const int left = static_cast<int>(width / 2 + width / 3 * std::sin(t * 0.4)) - 30;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const bool person = x >= left && x < left + 60 && y >= height / 4 && y < height - 20;
+            depth[y * width + x] = static_cast<int16_t>(person ? 2500 : 4000);
+        }
+    }
+}
+
+struct Robot
+{
+    std::unique_ptr<OffloadClient> client;
+    FrameTime due{ 0 };
+    size_t frame{ 0 };
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* host = "127.0.0.1";
+    int port = 7700;
+    int robotCount = 8;
+    int threadCount = 2;
+    double fps = 30.0;
+    double seconds = 10.0;
+    bool sendDepth = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) { host = argv[++i]; }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) { port = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--robots") == 0 && i + 1 < argc) { robotCount = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) { threadCount = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) { fps = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) { seconds = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--depth") == 0) { sendDepth = true; }
+    }
+    robotCount = std::max(robotCount, 1);
+    threadCount = std::min(std::max(threadCount, 1), robotCount);
+
+    // A second of pre-rendered depth, shared by every robot.
+    const int width = 320;
+    const int height = 240;
+    std::vector<std::vector<int16_t>> depthFrames(sendDepth ? 30 : 0);
+    for (size_t i = 0; i < depthFrames.size(); i++)
+    {
+        depthFrames[i].resize(width * height);
+        walking_depth(i / 30.0, depthFrames[i], width, height);
+    }
+
+    std::vector<Robot> robots(robotCount);
+    for (Robot& robot : robots)
+    {
+        robot.client.reset(new OffloadClient(host, port));
+        robot.client->set_send_depth(sendDepth);
+    }
+
+    // Let everyone connect before the clock starts.
+    const FrameTime connectBy = frame_clock_now() + 3000000000LL;
+    for (bool all = false; !all && frame_clock_now() < connectBy; )
+    {
+        all = true;
+        for (Robot& robot : robots)
+        {
+            robot.client->poll(frame_clock_now());
+            all = all && robot.client->ready();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const FrameTime period = fps > 0.0 ? static_cast<FrameTime>(1e9 / fps) : 0;
+    const FrameTime start = frame_clock_now();
+    const FrameTime end = start + static_cast<FrameTime>(seconds * 1e9);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t] {
+            astra_body_t body;
+            for (int r = t; r < robotCount; r += threadCount)
+            {
+                robots[r].due = start + period * r / robotCount;
+            }
+
+            for (FrameTime now = frame_clock_now(); now < end; now = frame_clock_now())
+            {
+                bool sent = false;
+                for (int r = t; r < robotCount; r += threadCount)
+                {
+                    Robot& robot = robots[r];
+                    robot.client->poll(now);
+                    if (period > 0 ? now < robot.due : !robot.client->ready()) { continue; }
+
+                    const double time = frame_time_seconds(now - start);
+                    BodyFrameView view;
+                    DepthView depth;
+                    if (sendDepth)
+                    {
+                        depth.data = depthFrames[robot.frame % depthFrames.size()].data();
+                        depth.width = width;
+                        depth.height = height;
+                    }
+                    else
+                    {
+                        walking_body(time, r, body);
+                        view.valid = true;
+                        view.bodies = &body;
+                        view.count = 1;
+                    }
+                    robot.client->send_frame(now, now, now, depth, view);
+                    robot.frame++;
+                    robot.due += period;
+                    sent = true;
+                }
+                if (!sent)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) { thread.join(); }
+
+    // Collect the last answers.
+    const FrameTime drainBy = frame_clock_now() + 200000000LL;
+    while (frame_clock_now() < drainBy)
+    {
+        for (Robot& robot : robots) { robot.client->poll(frame_clock_now()); }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    size_t sent = 0, dropped = 0, decisions = 0;
+    double rtt = 0.0;
+    FrameTime rttMax = 0;
+    for (Robot& robot : robots)
+    {
+        const OffloadClient::Stats& stats = robot.client->stats();
+        sent += stats.sent;
+        dropped += stats.dropped;
+        decisions += stats.decisions;
+        rtt += stats.rtt / 1e6 / robotCount;
+        rttMax = std::max(rttMax, stats.rttMax);
+    }
+    printf("Loadgen: %d robots, %zu frames sent, %zu dropped, %zu decisions\n",
+           robotCount, sent, dropped, decisions);
+    printf("Loadgen: %.1f decisions/s, rtt %.2f ms (max %.2f ms)\n",
+           decisions / seconds, rtt, rttMax / 1e6);
+    return 0;
+}
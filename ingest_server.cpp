@@ -0,0 +1,72 @@
+// Facility-wide offload host (see IngestServer.hpp): serves any number of
+// dogs at once, each with its own analysis state, on a pool of workers.
+//
+//   g++ -std=c++14 -O2 -I<sdk>/include ingest_server.cpp -pthread
+//       -o ingest_server
+//
+// Usage: ingest_server [--bind <address>] [--port <port>]
+//                      [--workers <n>] [--model <path>]
+//
+// Prints connections and frame throughput every five seconds.
+
+#include "IngestServer.hpp"
+#include <csignal>
+#include <cstdlib>
+
+static std::atomic<bool> stopping{ false };
+
+static void on_signal(int)
+{
+    stopping = true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* bind = "0.0.0.0";
+    const char* modelPath = "stgcn_model.bin";
+    int port = 7700;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) { bind = argv[++i]; }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) { port = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) { workers = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) { modelPath = argv[++i]; }
+    }
+
+    IngestServer server(workers);
+    if (!server.open(bind, port))
+    {
+        return 1;
+    }
+    server.load_model(modelPath);
+    printf("Ingest: listening on %s:%d with %d workers\n", bind, port, server.worker_count());
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    std::thread report([&server] {
+        IngestServer::Stats last = server.stats();
+        FrameTime lastTime = frame_clock_now();
+        while (!stopping.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            const FrameTime now = frame_clock_now();
+            if (now - lastTime < 5000000000LL) { continue; }
+
+            const IngestServer::Stats stats = server.stats();
+            printf("Ingest: %zu dogs, %.1f frames/s, %zu malformed, %zu steals\n",
+                   stats.connections, (stats.frames - last.frames) / frame_time_seconds(now - lastTime),
+                   stats.malformed, server.steals());
+            last = stats;
+            lastTime = now;
+        }
+    });
+
+    server.run(stopping);
+    report.join();
+
+    const IngestServer::Stats stats = server.stats();
+    printf("Ingest: %zu connections served, %zu frames\n", stats.accepted, stats.frames);
+    return 0;
+}
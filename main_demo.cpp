@@ -8,11 +8,31 @@
 #include <geometry_msgs/Twist.h>
 #include <stdlib.h>
 #include <string>
+#include "AllocCounter.hpp"
+#include "BodyAnalysis.hpp"
+#include "DepthFallbackTracker.hpp"
+#include "FrameKernels.hpp"
+#include "Recording.hpp"
+#include "ReplayDriver.hpp"
+#include "ClipCapture.hpp"
+#include "CmdVelWatchdog.hpp"
+#include "Config.hpp"
+#include "OffloadClient.hpp"
+#include "OffloadServer.hpp"
+#include "Metrics.hpp"
+#include "QualityGovernor.hpp"
+#include "StartupTimer.hpp"
+#include "Trace.hpp"
+#include <climits>
+#include <csignal>
+#include <cstdarg>
+#include <chrono>
+#include <thread>
 using namespace std;
-string posture = "";
 float waist[3][3];
 float manDis = 0;
 float angle = 0;
+ActionProbabilities actionProbs = {};
 class sfLine : public sf::Drawable
 {
 public:
@@ -49,73 +69,15 @@ class BodyVisualizer : public astra::FrameListener
 public:
     BodyVisualizer()
     {
-        font_.loadFromFile("Inconsolata.otf");
-    }
-
-    static sf::Color get_body_color(std::uint8_t bodyId)
-    {
-        if (bodyId == 0)
-        {
-            // Handle no body separately - transparent
-            return sf::Color(0x00, 0x00, 0x00, 0x00);
-        }
-        // Case 0 below could mean bodyId == 25 or
-        // above due to the "% 24".
-        switch (bodyId % 24) {
-        case 0:
-            return sf::Color(0x00, 0x88, 0x00, 0xFF);
-        case 1:
-            return sf::Color(0x00, 0x00, 0xFF, 0xFF);
-        case 2:
-            return sf::Color(0x88, 0x00, 0x00, 0xFF);
-        case 3:
-            return sf::Color(0x00, 0xFF, 0x00, 0xFF);
-        case 4:
-            return sf::Color(0x00, 0x00, 0x88, 0xFF);
-        case 5:
-            return sf::Color(0xFF, 0x00, 0x00, 0xFF);
-
-        case 6:
-            return sf::Color(0xFF, 0x88, 0x00, 0xFF);
-        case 7:
-            return sf::Color(0xFF, 0x00, 0xFF, 0xFF);
-        case 8:
-            return sf::Color(0x88, 0x00, 0xFF, 0xFF);
-        case 9:
-            return sf::Color(0x00, 0xFF, 0xFF, 0xFF);
-        case 10:
-            return sf::Color(0x00, 0xFF, 0x88, 0xFF);
-        case 11:
-            return sf::Color(0xFF, 0xFF, 0x00, 0xFF);
-
-        case 12:
-            return sf::Color(0x00, 0x88, 0x88, 0xFF);
-        case 13:
-            return sf::Color(0x00, 0x88, 0xFF, 0xFF);
-        case 14:
-            return sf::Color(0x88, 0x88, 0x00, 0xFF);
-        case 15:
-            return sf::Color(0x88, 0xFF, 0x00, 0xFF);
-        case 16:
-            return sf::Color(0x88, 0x00, 0x88, 0xFF);
-        case 17:
-            return sf::Color(0xFF, 0x00, 0x88, 0xFF);
-
-        case 18:
-            return sf::Color(0xFF, 0x88, 0x88, 0xFF);
-        case 19:
-            return sf::Color(0xFF, 0x88, 0xFF, 0xFF);
-        case 20:
-            return sf::Color(0x88, 0x88, 0xFF, 0xFF);
-        case 21:
-            return sf::Color(0x88, 0xFF, 0xFF, 0xFF);
-        case 22:
-            return sf::Color(0x88, 0xFF, 0x88, 0xFF);
-        case 23:
-            return sf::Color(0xFF, 0xFF, 0x88, 0xFF);
-        default:
-            return sf::Color(0xAA, 0xAA, 0xAA, 0xFF);
-        }
+        // Room for six full skeletons, so steady-state frames reuse it.
+        const size_t joints = ASTRA_MAX_BODIES * ASTRA_MAX_JOINTS;
+        jointPositions_.reserve(joints);
+        circles_.reserve(joints);
+        circleShadows_.reserve(joints);
+        boneLines_.reserve(joints);
+        boneShadows_.reserve(joints);
+        helpText_.setCharacterSize(150);
+        helpText_.setStyle(sf::Text::Bold);
     }
 
     void init_depth_texture(int width, int height)
@@ -164,103 +126,241 @@ public:
         double fps = 1.0 / frameDuration_;
 
         printf("FPS: %3.1f (%3.4Lf ms)\n", fps, frameDuration_ * 1000);
-        posture+="FPS:";
-        stringstream out1;
-        out1<<fixed<<setprecision(3)<<fps;
-        string s10 = out1.str();
-        posture+=s10;
-        posture+="\n";
+        append_status("FPS:%.3f\n", fps);
+    }
+
+    // The on-screen status of the current frame, built without touching
+    // the heap; text past the buffer is dropped.
+    void append_status(const char* format, ...)
+    {
+        if (statusLength_ >= sizeof(status_) - 1) { return; }
+        va_list args;
+        va_start(args, format);
+        const int n = vsnprintf(status_ + statusLength_, sizeof(status_) - statusLength_, format, args);
+        va_end(args);
+        if (n > 0) { statusLength_ = std::min(statusLength_ + n, sizeof(status_) - 1); }
+    }
+
+    void clear_status()
+    {
+        statusLength_ = 0;
+        status_[0] = '\0';
     }
 
     void processDepth(astra::Frame& frame)
     {
+        TRACE_ZONE("processDepth");
         const astra::DepthFrame depthFrame = frame.get<astra::DepthFrame>();
 
+        depth_ = DepthView();
         if (!depthFrame.is_valid()) { return; }
 
-        int width = depthFrame.width();
-        int height = depthFrame.height();
-
-        init_depth_texture(width, height);
+        depth_.data = depthFrame.data();
+        depth_.width = depthFrame.width();
+        depth_.height = depthFrame.height();
+        depth_.frameIndex = depthFrame.frame_index();
 
-        const int16_t* depthPtr = depthFrame.data();
-        for (int y = 0; y < height; y++)
-        {
-            for (int x = 0; x < width; x++)
-            {
-                int index = (x + y * width);
-                int index4 = index * 4;
+        process_depth_data(depth_);
+    }
 
-                int16_t depth = depthPtr[index];
-                uint8_t value = depth % 255;
+    void process_depth_data(const DepthView& depth)
+    {
+        if (!rendering_) { return; }
+        int width = depth.width;
+        int height = depth.height;
 
-                displayBuffer_[index4] = value;
-                displayBuffer_[index4 + 1] = value;
-                displayBuffer_[index4 + 2] = value;
-                displayBuffer_[index4 + 3] = 255;
-            }
-        }
+        init_depth_texture(width, height);
+        depth_to_rgba(depth.data, width, height, displayBuffer_.get());
 
         texture_.update(displayBuffer_.get());
     }
 
     void processBodies(astra::Frame& frame)
     {
+        TRACE_ZONE("processBodies");
         astra::BodyFrame bodyFrame = frame.get<astra::BodyFrame>();
 
+        bodyView_ = BodyFrameView();
+        if (bodyFrame.is_valid() && bodyFrame.info().width() != 0 && bodyFrame.info().height() != 0)
+        {
+            const auto& bodies = bodyFrame.bodies();
+            const auto& floor = bodyFrame.floor_info(); //floor
+            const auto& bodyMask = bodyFrame.body_mask();
+            const auto& floorMask = floor.floor_mask();
+
+            bodyView_.valid = true;
+            bodyView_.frameIndex = bodyFrame.frame_index();
+            bodyView_.width = bodyFrame.info().width();
+            bodyView_.height = bodyFrame.info().height();
+            bodyView_.count = static_cast<int>(bodies.size());
+            bodyView_.bodies = bodyView_.count > 0 ? &reinterpret_cast<const astra_body_t&>(bodies[0]) : nullptr;
+            bodyView_.floorPlane = reinterpret_cast<const astra_plane_t&>(floor.floor_plane());
+            bodyView_.floorDetected = floor.floor_detected();
+            bodyView_.bodyMask = bodyMask.data();
+            bodyView_.floorMask = floorMask.data();
+            bodyView_.maskWidth = bodyMask.width();
+            bodyView_.maskHeight = bodyMask.height();
+        }
+
+        process_body_data(bodyView_);
+    }
+
+    void process_body_data(const BodyFrameView& view)
+    {
+        accident_ = false;
         jointPositions_.clear();
-        circles_.clear();
-        circleShadows_.clear();
+        jointCount_ = 0;
         boneLines_.clear();
         boneShadows_.clear();
 
-        if (!bodyFrame.is_valid() || bodyFrame.info().width() == 0 || bodyFrame.info().height() == 0)
+        const bool sdkHasBodies = view.valid && view.count > 0;
+        emptyBodyFrames_ = sdkHasBodies ? 0 : emptyBodyFrames_ + 1;
+
+        // The licensed tracker sometimes delivers nothing for long stretches;
+        // keep the fall and follow logic alive on raw depth meanwhile.
+        if (emptyBodyFrames_ > fallbackDelayFrames_)
+        {
+            if (!usingFallback_)
+            {
+                fallbackTracker_.reset_background();
+                usingFallback_ = true;
+            }
+            processFallbackBodies();
+            return;
+        }
+        usingFallback_ = false;
+
+        if (!view.valid)
+        {
+            clear_overlay();
+            return;
+        }
+
+        featureCount_ = 0;
+        for (int i = 0; i < view.count; i++)
+        {
+            rawBodies_[featureCount_++] = &view.bodies[i];
+        }
+
+        process_body_list(view.frameIndex, view.width, view.floorPlane, view.floorDetected);
+
+        if (view.floorDetected)
+        {
+            const auto& p = view.floorPlane;
+            std::cout << "Floor plane: ["
+                << p.a << ", " << p.b << ", " << p.c << ", " << p.d
+                << "]" << std::endl;
+
+        }
+
+        if (view.bodyMask != nullptr && view.floorMask != nullptr)
+        {
+            update_overlay(view.bodyMask, view.floorMask, view.maskWidth, view.maskHeight);
+        }
+        else
+        {
+            clear_overlay();
+        }
+    }
+
+    void processFallbackBodies()
+    {
+        TRACE_ZONE("processFallbackBodies");
+        if (!depth_.is_valid())
         {
             clear_overlay();
             return;
         }
 
-        const float jointScale = bodyFrame.info().width() / 120.f;
+        const int count = fallbackTracker_.process(depth_.data, depth_.width, depth_.height, fallbackBodies_,
+                                                   arenas_.frame());
+
+        featureCount_ = 0;
+        for (int i = 0; i < count; i++)
+        {
+            rawBodies_[featureCount_++] = &fallbackBodies_.bodies[i];
+        }
+
+        process_body_list(depth_.frameIndex, depth_.width, astra_plane_t{ 0.f, 0.f, 0.f, 0.f }, false);
+        clear_overlay();
+    }
+
+    // Counts accidents as they start, keeps recent frames for review and
+    // saves them when one does.
+    void capture_clip()
+    {
+        TRACE_ZONE("capture_clip");
+        const bool started = accident_ && !accidentActive_;
+        accidentActive_ = accident_;
+        if (started) { metrics_.alarmsRaised.add(); }
+
+        if (clipCapture_ == nullptr) { return; }
+
+        clipCapture_->push(frameTime_, depth_, bodyView_);
+        if (started)
+        {
+            clipCapture_->trigger(frameTime_);
+        }
+    }
+
+    void offload_frame()
+    {
+        TRACE_ZONE("offload_frame");
+        if (offload_ == nullptr) { return; }
+
+        MetricTimer timer(metrics_.stageLatency[PipelineMetrics::STAGE_OFFLOAD]);
+        offload_->send_frame(frame_clock_now(), frameTime_, frameArrival_, depth_, bodyView_);
+    }
+
+    // Counts the frame, and the ones the sensor skipped before it.
+    void count_frame(astra_frame_index_t frameIndex)
+    {
+        metrics_.framesReceived.add();
+        if (lastFrameIndex_ != 0 && frameIndex > lastFrameIndex_ + 1)
+        {
+            metrics_.framesDropped.add(frameIndex - lastFrameIndex_ - 1);
+        }
+        lastFrameIndex_ = frameIndex;
+    }
+
+    // Posture analysis and skeleton drawing for the bodies in rawBodies_.
+    void process_body_list(astra_frame_index_t frameIndex, int frameWidth,
+        const astra_plane_t& floorPlane, bool floorDetected)
+    {
+        TRACE_ZONE("process_body_list");
+        const float jointScale = frameWidth / 120.f;
 
-        const auto& bodies = bodyFrame.bodies();
+        // The host runs the learned model while the offload link is up.
+        analyzer_.set_model_enabled(modelAllowed_ && (offload_ == nullptr || !offload_->healthy(frame_clock_now())));
+        {
+            MetricTimer timer(metrics_.stageLatency[PipelineMetrics::STAGE_ANALYSIS]);
+            analyzer_.analyze(frameTime_, rawBodies_.data(), featureCount_, floorPlane, floorDetected, arenas_);
+            decision_ = analyzer_.decide();
+            decision_.sourceTime = frameArrival_;
+        }
+        metrics_.bodiesTracked.set(featureCount_);
+        if (featureCount_ > 0) { skeletonSeen_ = true; }
 
-        for (auto& body : bodies)
+        for (int bodyIndex = 0; bodyIndex < featureCount_; bodyIndex++)
         {
+            const astra::Body& body = reinterpret_cast<const astra::Body&>(*rawBodies_[bodyIndex]);
             // printf("Processing%d frame #%d body %d left hand: %u\n",
-            //   bodyFrame.frame_index(), body.id(), unsigned(body.hand_poses().left_hand()),body.id());
+            //   frameIndex, body.id(), unsigned(body.hand_poses().left_hand()),body.id());
             printf("frame_index:%d \nbody_id:%d \ncenter_of_mass:%f %f %f  \n",
-                bodyFrame.frame_index(), body.id(), body.center_of_mass().x, body.center_of_mass().y, body.center_of_mass().z);
+                frameIndex, body.id(), body.center_of_mass().x, body.center_of_mass().y, body.center_of_mass().z);
             for (auto& joint : body.joints())
             {
                 printf("joint_info:\ntype:%d\nworld_position:%f %f %f\ndepth_position:%f %f\n",
                     joint.type(), joint.world_position().x, joint.world_position().y, joint.world_position().z, joint.depth_position().x, joint.depth_position().y);
                 jointPositions_.push_back(joint.depth_position());
             }
-        posture += "unknown";
-        
-        manDis = sqrt(body.joints()[9].world_position().x * body.joints()[9].world_position().x + body.joints()[9].world_position().z * body.joints()[9].world_position().z);
-        
-        if (body.center_of_mass().y - body.joints()[12].world_position().y < 400) {
-            posture+="accident";
-        }else{
-            posture+="safe";
-        }
-        posture+="\ndistance:";
-        manDis = manDis/1000.0;
-        stringstream out;
-        out<<fixed<<setprecision(3)<<manDis;
-        string s5 = out.str();
-        posture+=s5;
-
-        posture+="m\nangle:";
-
-                
-        stringstream out2;
-        angle = atan2(body.joints()[9].world_position().z, body.joints()[9].world_position().x);
-        angle = body.joints()[9].world_position().x;
-        out2<<fixed<<setprecision(3)<<angle;
-        s5 = out2.str();
-        posture+=s5;
+        const BodyAnalysis& analysis = analyzer_.result(bodyIndex);
+        actionProbs = analysis.probabilities;
+        manDis = analysis.distance;
+        angle = analysis.lateral;
+        accident_ = accident_ || analysis.accident;
+        append_status("%s\n%s\ndistance:%.3fm\nangle:%.3f\n", action_name(analysis.action),
+                      analysis.accident ? "accident" : "safe", manDis, angle);
             for (size_t i = 2; i > 0; i--)
             {
                 for (size_t j = 0; j < 3; j++) {
@@ -269,25 +369,11 @@ public:
             }
 
 
-        update_body(body, jointScale);
+        if (rendering_) { update_body(body, jointScale); }
     }
-        const auto& floor = bodyFrame.floor_info(); //floor
-        if (floor.floor_detected())
-        {
-            const auto& p = floor.floor_plane();
-            std::cout << "Floor plane: ["
-                << p.a() << ", " << p.b() << ", " << p.c() << ", " << p.d()
-                << "]" << std::endl;
-
-        }
-
-        const auto& bodyMask = bodyFrame.body_mask();
-        const auto& floorMask = floor.floor_mask();
-
-        update_overlay(bodyMask, floorMask);
     }
 
-    void update_body(astra::Body body,
+    void update_body(const astra::Body& body,
         const float jointScale)
     {
         const auto& joints = body.joints();
@@ -323,16 +409,22 @@ public:
             const auto shadowRadius = radius + shadowRadius_ * jointScale;
             const auto radiusDelta = shadowRadius - radius;
 
-            sf::CircleShape circle(radius);
-
+            // Shapes are pooled; a new CircleShape allocates its vertices.
+            if (jointCount_ == circles_.size())
+            {
+                circles_.emplace_back();
+                circleShadows_.emplace_back();
+            }
+            sf::CircleShape& circle = circles_[jointCount_];
+            circle.setRadius(radius);
             circle.setFillColor(sf::Color(color.r, color.g, color.b, 255));
             circle.setPosition(pos.x - radius, pos.y - radius);
-            circles_.push_back(circle);
 
-            sf::CircleShape shadow(shadowRadius);
+            sf::CircleShape& shadow = circleShadows_[jointCount_];
+            shadow.setRadius(shadowRadius);
             shadow.setFillColor(circleShadowColor);
             shadow.setPosition(circle.getPosition() - sf::Vector2f(radiusDelta, radiusDelta));
-            circleShadows_.push_back(shadow);
+            jointCount_++;
         }
 
         update_bone(joints, jointScale, astra::JointType::Head, astra::JointType::Neck);
@@ -401,46 +493,20 @@ public:
             shadowLineThickness));
     }
 
-    void update_overlay(const astra::BodyMask& bodyMask,
-        const astra::FloorMask& floorMask)
+    void update_overlay(const uint8_t* bodyData,
+        const uint8_t* floorData, const int width, const int height)
     {
-        const auto* bodyData = bodyMask.data();
-        const auto* floorData = floorMask.data();
-        const int width = bodyMask.width();
-        const int height = bodyMask.height();
-
+        TRACE_ZONE("update_overlay");
+        if (!rendering_) { return; }
         init_overlay_texture(width, height);
-
-        const int length = width * height;
-
-        for (int i = 0; i < length; i++)
-        {
-            const auto bodyId = bodyData[i];
-            const auto isFloor = floorData[i];
-
-            sf::Color color(0x0, 0x0, 0x0, 0x0);
-
-            if (bodyId != 0)
-            {
-                color = get_body_color(bodyId);
-            }
-            else if (isFloor != 0)
-            {
-                color = sf::Color(0x0, 0x0, 0xFF, 0x88);
-            }
-
-            const int rgbaOffset = i * 4;
-            overlayBuffer_[rgbaOffset] = color.r;
-            overlayBuffer_[rgbaOffset + 1] = color.g;
-            overlayBuffer_[rgbaOffset + 2] = color.b;
-            overlayBuffer_[rgbaOffset + 3] = color.a;
-        }
+        masks_to_rgba(bodyData, floorData, width, height, overlayBuffer_.get());
 
         overlayTexture_.update(overlayBuffer_.get());
     }
 
     void clear_overlay()
     {
+        if (!rendering_) { return; }
         int byteLength = overlayWidth_ * overlayHeight_ * 4;
         std::fill(&overlayBuffer_[0], &overlayBuffer_[0] + byteLength, 0);
 
@@ -450,12 +516,152 @@ public:
     virtual void on_frame_ready(astra::StreamReader& reader,
         astra::Frame& frame) override
     {
-
+        TRACE_ZONE("on_frame_ready");
+        const AllocationScope allocations;
+        arenas_.reset();
+        clear_status();
         check_fps();
         if (isPaused_) { return; }
 
-        processDepth(frame);
-        processBodies(frame);
+        MetricTimer timer(metrics_.stageLatency[PipelineMetrics::STAGE_FRAME]);
+        frameTime_ = frame_clock_now();
+        frameArrival_ = frameTime_;
+
+        {
+            MetricTimer depthTimer(metrics_.stageLatency[PipelineMetrics::STAGE_DEPTH]);
+            processDepth(frame);
+        }
+        {
+            MetricTimer bodyTimer(metrics_.stageLatency[PipelineMetrics::STAGE_BODIES]);
+            processBodies(frame);
+        }
+        count_frame(bodyView_.valid ? bodyView_.frameIndex : depth_.frameIndex);
+
+        if (recorder_ != nullptr)
+        {
+            MetricTimer recordTimer(metrics_.stageLatency[PipelineMetrics::STAGE_RECORD]);
+            recorder_->write_frame(frameTime_, depth_, bodyView_);
+        }
+        capture_clip();
+        offload_frame();
+        metrics_.arenaHighWater.set(static_cast<double>(arenas_.high_water()));
+        check_allocations(allocations, "live frame");
+    }
+
+    // Runs a recorded frame through the same path as a live one.
+    void process_recorded(const FrameRef& frame)
+    {
+        TRACE_ZONE("process_recorded");
+        if (isPaused_) { return; }
+        const AllocationScope allocations;
+        arenas_.reset();
+        clear_status();
+
+        MetricTimer timer(metrics_.stageLatency[PipelineMetrics::STAGE_FRAME]);
+        frameTime_ = frame.timestamp;
+        frameArrival_ = frame_clock_now();
+        depth_ = frame.depth;
+        if (depth_.is_valid())
+        {
+            MetricTimer depthTimer(metrics_.stageLatency[PipelineMetrics::STAGE_DEPTH]);
+            process_depth_data(depth_);
+        }
+        bodyView_ = frame.body;
+        {
+            MetricTimer bodyTimer(metrics_.stageLatency[PipelineMetrics::STAGE_BODIES]);
+            process_body_data(bodyView_);
+        }
+        count_frame(bodyView_.valid ? bodyView_.frameIndex : depth_.frameIndex);
+        capture_clip();
+        offload_frame();
+        metrics_.arenaHighWater.set(static_cast<double>(arenas_.high_water()));
+        check_allocations(allocations, "replayed frame");
+    }
+
+    // Once warmed up, the frame path must not touch the heap. Builds with
+    // -DDOG_ALLOC_COUNT count what it did anyway and say where.
+    void check_allocations(const AllocationScope& allocations, const char* where)
+    {
+        if (!heap_counting_enabled() || metrics_.framesReceived.value() <= kAllocationWarmupFrames) { return; }
+        const uint64_t count = allocations.count();
+        if (count == 0) { return; }
+        metrics_.heapAllocations.add(count);
+        printf("Alloc: %llu heap allocations in %s %llu\n", static_cast<unsigned long long>(count), where,
+               static_cast<unsigned long long>(metrics_.framesReceived.value()));
+    }
+
+    void set_recorder(FrameRecorder* recorder)
+    {
+        recorder_ = recorder;
+    }
+
+    void set_clip_capture(ClipCapture* clipCapture)
+    {
+        clipCapture_ = clipCapture;
+    }
+
+    void set_offload(OffloadClient* offload)
+    {
+        offload_ = offload;
+    }
+
+    PipelineMetrics& metrics() { return metrics_; }
+
+    // Off, frames are still analysed but the viewer's textures and shapes
+    // are left alone; the main loop stops drawing too.
+    void set_rendering(bool rendering)
+    {
+        rendering_ = rendering;
+    }
+
+    bool is_rendering() const { return rendering_; }
+
+    void set_model_interval(int interval)
+    {
+        analyzer_.set_model_interval(interval);
+    }
+
+    // Until a model is attached, actions come from the streaming
+    // classifier alone. Call between frames.
+    void attach_model(const stgcn::Model& model)
+    {
+        analyzer_.attach_model(model);
+    }
+
+    // The overlay font loads on another thread while frames already flow;
+    // the status text shows up once it is in.
+    void load_font(const char* path)
+    {
+        if (font_.loadFromFile(path))
+        {
+            fontLoaded_.store(true, std::memory_order_release);
+        }
+    }
+
+    // Whether any frame so far had a body in it.
+    bool skeleton_seen() const { return skeletonSeen_; }
+
+    // The config file's part of the listener.
+    void set_thresholds(const AnalysisThresholds& thresholds, bool model)
+    {
+        analyzer_.set_thresholds(thresholds);
+        modelAllowed_ = model;
+    }
+    const FrameArenas& arenas() const { return arenas_; }
+
+    // What to do next: the analysis host's decision while the link is
+    // healthy, our own otherwise.
+    FollowDecision follow_decision(FrameTime now)
+    {
+        if (offload_ != nullptr)
+        {
+            offload_->poll(now);
+            if (offload_->healthy(now))
+            {
+                return offload_->decision();
+            }
+        }
+        return decision_;
     }
 
     void draw_bodies(sf::RenderWindow& window)
@@ -471,14 +677,14 @@ public:
         for (const auto& bone : boneShadows_)
             window.draw(bone, states);
 
-        for (const auto& c : circleShadows_)
-            window.draw(c, states);
+        for (size_t i = 0; i < jointCount_; i++)
+            window.draw(circleShadows_[i], states);
 
         for (const auto& bone : boneLines_)
             window.draw(bone, states);
 
-        for (auto& c : circles_)
-            window.draw(c, states);
+        for (size_t i = 0; i < jointCount_; i++)
+            window.draw(circles_[i], states);
 
     }
 
@@ -497,33 +703,33 @@ public:
         window.draw(text);
     }
 
-    void draw_help_message(sf::RenderWindow& window) const
+    void draw_help_message(sf::RenderWindow& window)
     {
-        if (!isMouseOverlayEnabled_) {
+        if (!isMouseOverlayEnabled_ || !fontLoaded_.load(std::memory_order_acquire)) {
             return;
         }
-
-        std::stringstream str;
-        str << posture;
-
-        if (isFullHelpEnabled_ && helpMessage_ != nullptr)
+        if (helpText_.getFont() == nullptr) { helpText_.setFont(font_); }
+
+        // sf::Text copies the string into its own, so only hand it over
+        // when the text changed.
+        const char* help = isFullHelpEnabled_ && helpMessage_ != nullptr ? helpMessage_ : "";
+        char text[sizeof(status_) + 1024];
+        snprintf(text, sizeof(text), "%s%s%s", status_, help[0] != '\0' ? "\n" : "", help);
+        if (strcmp(text, shownText_) != 0)
         {
-            str << "\n" << helpMessage_;
+            memcpy(shownText_, text, sizeof(shownText_));
+            helpText_.setString(shownText_);
         }
 
-        const int characterSize = 150;
-        sf::Text text(str.str(), font_);
-        text.setCharacterSize(characterSize);
-        text.setStyle(sf::Text::Bold);
-
         const float displayX = 0.f;
         const float displayY = 0;
 
-        draw_text(window, text, sf::Color::White, displayX, displayY);
+        draw_text(window, helpText_, sf::Color::White, displayX, displayY);
     }
 
     void draw_to(sf::RenderWindow& window)
     {
+        TRACE_ZONE("draw_to");
         if (displayBuffer_ != nullptr)
         {
             const float scaleX = window.getView().getSize().x / depthWidth_;
@@ -574,18 +780,62 @@ public:
     {
         helpMessage_ = msg;
     }
+
+    // Number of consecutive frames without SDK bodies before the depth-only
+    // tracker takes over; 0 when there is no body tracking license.
+    void set_fallback_delay(int frames)
+    {
+        fallbackDelayFrames_ = frames;
+    }
+
+    // Feature vectors of the bodies in the last processed frame.
+    int feature_count() const { return analyzer_.count(); }
+    astra::BodyId feature_body_id(int i) const { return analyzer_.result(i).id; }
+    const BodyFeatureVector& body_features(int i) const { return analyzer_.features(i); }
+
+    // Action probabilities of body i; the streaming classifier fused with
+    // the ST-GCN model when one is loaded.
+    const ActionProbabilities& action_probabilities(int i) const { return analyzer_.result(i).probabilities; }
 private:
     long double frameDuration_{ 0 };
     std::clock_t lastTimepoint_{ 0 };
     sf::Texture texture_;
     sf::Sprite sprite_;
     sf::Font font_;
+    std::atomic<bool> fontLoaded_{ false };
 
     using BufferPtr = std::unique_ptr < uint8_t[] >;
     BufferPtr displayBuffer_{ nullptr };
 
     std::vector<astra::Vector2f> jointPositions_;
 
+    FrameTime frameTime_{ 0 };
+    FrameTime frameArrival_{ 0 };   // on the frame clock, replayed frames too
+    DepthView depth_;
+    BodyFrameView bodyView_;
+    FrameRecorder* recorder_{ nullptr };
+    ClipCapture* clipCapture_{ nullptr };
+    OffloadClient* offload_{ nullptr };
+    PipelineMetrics metrics_;
+    FrameArenas arenas_;    // scratch of the frame in progress
+    bool rendering_{ true };
+    bool modelAllowed_{ true };
+    astra_frame_index_t lastFrameIndex_{ 0 };
+    bool accident_{ false };
+    bool accidentActive_{ false };
+    int featureCount_{ 0 };
+    bool skeletonSeen_{ false };
+    std::array<const astra_body_t*, ASTRA_MAX_BODIES> rawBodies_;
+
+    DepthFallbackTracker fallbackTracker_;
+    astra_body_list_t fallbackBodies_;
+    int fallbackDelayFrames_{ 30 };
+    int emptyBodyFrames_{ 0 };
+    bool usingFallback_{ false };
+
+    BodyAnalyzer analyzer_;
+    FollowDecision decision_;
+
     int depthWidth_{ 0 };
     int depthHeight_{ 0 };
     int overlayWidth_{ 0 };
@@ -593,8 +843,9 @@ private:
 
     std::vector<sfLine> boneLines_;
     std::vector<sfLine> boneShadows_;
-    std::vector<sf::CircleShape> circles_;
+    std::vector<sf::CircleShape> circles_;        // pooled, first jointCount_ in use
     std::vector<sf::CircleShape> circleShadows_;
+    size_t jointCount_{ 0 };
 
     float lineThickness_{ 0.5f }; // pixels
     float jointRadius_{ 1.0f };   // pixels
@@ -608,25 +859,48 @@ private:
     bool isMouseOverlayEnabled_{ true };
     bool isFullHelpEnabled_{ false };
     const char* helpMessage_{ nullptr };
+
+    // Buffers, pools and the model's state settle within the first couple
+    // of seconds.
+    static constexpr uint64_t kAllocationWarmupFrames = 60;
+
+    char status_[1024] = { 0 };
+    size_t statusLength_{ 0 };
+    sf::Text helpText_;
+    char shownText_[sizeof(status_) + 1024] = { 0 };
 };
 
-astra::DepthStream configure_depth(astra::StreamReader& reader)
+// Switches the depth mode, on a running stream too; does nothing when it
+// is already in that mode.
+void set_depth_mode(astra::DepthStream& depthStream, int width, int height, int fps)
 {
-    auto depthStream = reader.stream<astra::DepthStream>();
+    const astra::ImageStreamMode current = depthStream.mode();
+    if (static_cast<int>(current.width()) == width && static_cast<int>(current.height()) == height &&
+        static_cast<int>(current.fps()) == fps)
+    {
+        return;
+    }
 
-    //We don't have to set the mode to start the stream, but if you want to here is how:
     astra::ImageStreamMode depthMode;
-
-    depthMode.set_width(640);
-    depthMode.set_height(480);
+    depthMode.set_width(width);
+    depthMode.set_height(height);
     depthMode.set_pixel_format(astra_pixel_formats::ASTRA_PIXEL_FORMAT_DEPTH_MM);
-    depthMode.set_fps(30);
-
+    depthMode.set_fps(fps);
     depthStream.set_mode(depthMode);
+    printf("Depth: %dx%d at %d fps\n", width, height, fps);
+}
+
+astra::DepthStream configure_depth(astra::StreamReader& reader, const DogConfig& config)
+{
+    auto depthStream = reader.stream<astra::DepthStream>();
+
+    //We don't have to set the mode to start the stream, but if you want to here is how:
+    set_depth_mode(depthStream, config.depthWidth, config.depthHeight, config.depthFps);
 
     return depthStream;
 }
-void robotMove(double lx,double ly,double lz,double ax,double ay,double az,ros::Publisher &pub,ros::Rate &rate){
+void robotMove(double lx,double ly,double lz,double ax,double ay,double az,ros::Publisher &pub){
+    TRACE_ZONE("robotMove");
     if(ros::ok){
         geometry_msgs::Twist msg;
         msg.linear.x = lx;
@@ -636,24 +910,125 @@ void robotMove(double lx,double ly,double lz,double ax,double ay,double az,ros::
         msg.angular.y = ay;
         msg.angular.z = az;
         pub.publish(msg);
-        ROS_INFO_STREAM("Sending random velocity command:"<<" linear="<<msg.linear.x<<" angular="<<msg.angular.z);
-        rate.sleep();
+        ROS_DEBUG("Sending random velocity command: linear=%g angular=%g", msg.linear.x, msg.angular.z);
     }
 }
 
+static std::atomic<bool> traceRequested{ false };
+static std::atomic<bool> stopRequested{ false };
+
+static void on_trace_signal(int)
+{
+    traceRequested = true;
+}
+
+static void on_stop_signal(int)
+{
+    stopRequested = true;
+}
+
 int main(int argc, char** argv)
 {
+    // Counts from process launch; see the "Startup:" lines once the first
+    // skeleton is in.
+    StartupTimer startup;
+
     for (size_t i = 0; i < 3; i++)
     {
         for (size_t j = 0; j < 3; j++) {
             waist[i][j] = 0;
         }
     }
+
+    // [license file] [--record <path>] [--clips <dir>]
+    // [--replay <path> [--seek <seconds>] [--speed <x>] [--bench]]
+    // [--offload <host:port>|loopback [--offload-depth]] [--metrics <port>]
+    // [--trace <path>] [--latency-budget <ms>] [--quality <level>]
+    // [--config <path>] [--headless]
+    const char* licensePath = nullptr;
+    const char* recordPath = nullptr;
+    const char* clipDirectory = nullptr;
+    const char* replayPath = nullptr;
+    double seekSeconds = 0.0;
+    double replaySpeed = 1.0;
+    bool benchmark = false;
+    const char* offloadAddress = nullptr;
+    bool offloadDepth = false;
+    int metricsPort = 0;
+    const char* tracePath = nullptr;
+    double latencyBudgetMs = -1.0;
+    int qualityLevel = -1;
+    const char* configPath = "dog.toml";
+    bool headless = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) { recordPath = argv[++i]; }
+        else if (strcmp(argv[i], "--clips") == 0 && i + 1 < argc) { clipDirectory = argv[++i]; }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) { replayPath = argv[++i]; }
+        else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) { seekSeconds = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) { replaySpeed = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--bench") == 0) { benchmark = true; }
+        else if (strcmp(argv[i], "--offload") == 0 && i + 1 < argc) { offloadAddress = argv[++i]; }
+        else if (strcmp(argv[i], "--offload-depth") == 0) { offloadDepth = true; }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) { metricsPort = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) { tracePath = argv[++i]; }
+        else if (strcmp(argv[i], "--latency-budget") == 0 && i + 1 < argc) { latencyBudgetMs = atof(argv[++i]); }
+        else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc) { qualityLevel = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) { configPath = argv[++i]; }
+        else if (strcmp(argv[i], "--headless") == 0) { headless = true; }
+        else if (argv[i][0] != '-' && licensePath == nullptr) { licensePath = argv[i]; }
+    }
+    const bool benchmarking = benchmark && replayPath != nullptr;
+    headless = headless || benchmarking;
+
+    // Startup runs three ways at once: the ROS node (registering with the
+    // master can take seconds) and the UI font and ST-GCN model each load
+    // on their own thread while the sensor comes up here. Frames are
+    // processed as soon as they arrive; the model is attached, and
+    // /cmd_vel published, once they are ready.
+    struct RosLink
+    {
+        std::unique_ptr<ros::NodeHandle> node;
+        ros::Publisher pub;
+    };
+    RosLink rosLink;
+    std::atomic<bool> rosReady{ false };
+    std::thread rosThread;
+    int rosArgc = argc;
+    if (!benchmarking)
+    {
+        rosThread = std::thread([&] {
+            ros::init(rosArgc, argv, "publish_velocity", ros::init_options::NoSigintHandler);
+            rosLink.node.reset(new ros::NodeHandle);
+            rosLink.pub = rosLink.node->advertise<geometry_msgs::Twist>("/cmd_vel", 1000);
+            startup.mark("ros");
+            rosReady.store(true, std::memory_order_release);
+        });
+    }
+
+    BodyVisualizer listener;
+    stgcn::Model model;
+    std::atomic<bool> resourcesLoaded{ false };
+    std::thread resourceThread([&] {
+        if (!headless)
+        {
+            listener.load_font("Inconsolata.otf");
+            startup.mark("font");
+        }
+        if (model.load("stgcn_model.bin")) { startup.mark("model"); }
+        resourcesLoaded.store(true, std::memory_order_release);
+    });
+    auto finishLoading = [&](bool wait) {
+        if (!resourceThread.joinable() || (!wait && !resourcesLoaded.load(std::memory_order_acquire))) { return; }
+        resourceThread.join();
+        if (model.is_loaded()) { listener.attach_model(model); }
+    };
+
     astra::initialize();
 
-    if (argc == 2)
+    if (licensePath != nullptr)
     {
-        FILE* fp = fopen(argv[1], "rb");
+        FILE* fp = fopen(licensePath, "rb");
         char licenseString[1024] = { 0 };
         fread(licenseString, 1, 1024, fp);
         orbbec_body_tracking_set_license(licenseString);
@@ -666,56 +1041,288 @@ int main(int argc, char** argv)
         orbbec_body_tracking_set_license(licenseString);
     }
 
-    sf::RenderWindow window(sf::VideoMode(1280, 960), "Simple Body Viewer");
+    astra::StreamSet sensor;
+    astra::StreamReader reader = sensor.create_reader();
+
+    // Tunables come from the config file and are re-read when it is
+    // saved; a bad edit is reported and ignored.
+    DogConfig config;
+    load_config(configPath, config);
+    ConfigWatcher configWatcher;
+    configWatcher.watch(configPath);
+
+    // /cmd_vel goes out from the watchdog's thread once the node is up, at
+    // the configured rate, and winds down to zero when frames stop coming.
+    CmdVelWatchdog watchdog([&](float linear, float angular) {
+        robotMove(linear,0,0,0,0,angular,rosLink.pub);
+        listener.metrics().cmdVelPublished.add();
+        listener.metrics().cmdVelLastPublish.store(frame_clock_now(), std::memory_order_relaxed);
+    });
+
+    // The governor trades quality for latency and heat; see
+    // QualityGovernor. --quality pins a level, a budget of 0 keeps full
+    // quality. --latency-budget overrides the config file.
+    QualityGovernor governor;
+    bool governed = false;
+    auto configurePipeline = [&] {
+        listener.set_thresholds(config.thresholds, config.model);
+        // Without a body tracking license the SDK never finds anyone.
+        listener.set_fallback_delay(licensePath != nullptr ? config.fallbackDelay : 0);
+        watchdog.set_rate(config.cmdVelRate);
+        watchdog.configure_follow(config.thresholds, config.pursuit);
+        watchdog.set_limits(static_cast<FrameTime>(config.maxDataAge * 1e6), static_cast<FrameTime>(config.stopRamp * 1e6));
+
+        const double budget = latencyBudgetMs >= 0.0 ? latencyBudgetMs : config.latencyBudget;
+        governor.set_latency_budget(static_cast<FrameTime>(budget * 1e6));
+        governed = budget > 0.0 || qualityLevel >= 0;
+        if (qualityLevel >= 0) { governor.set_level_range(qualityLevel, qualityLevel); }
+        else { governor.set_level_range(0, governed ? INT_MAX : 0); }
+    };
+    configurePipeline();
+
+    // Replayed frames go through the same processing as live ones; the
+    // sensor streams are left alone. --bench replays the whole recording
+    // unthrottled without a window and reports throughput.
+    MappedRecording replay;
+    ReplayDriver replayDriver(replay, benchmarking ? 0.0 : replaySpeed);
+    auto replaySink = [&listener](const FrameRef& frame) { listener.process_recorded(frame); };
+    if (replayPath != nullptr && replay.open(replayPath))
+    {
+        replayDriver.start(static_cast<FrameTime>(seekSeconds * 1e9), frame_clock_now());
+    }
+
+    auto depthStream = configure_depth(reader, config);
+    auto bodyStream = reader.stream<astra::BodyStream>();
+    if (!replay.is_open())
+    {
+        depthStream.start();
+        bodyStream.start();
+        reader.add_listener(listener);
+    }
+    startup.mark("sensor");
+
+    // Prometheus can scrape http://<dog>:<port>/metrics.
+    MetricsRegistry metricsRegistry;
+    MetricsServer metricsServer(metricsRegistry);
+    if (metricsPort > 0)
+    {
+        listener.metrics().register_with(metricsRegistry);
+        governor.register_with(metricsRegistry);
+        watchdog.register_with(metricsRegistry);
+        metricsServer.start("0.0.0.0", metricsPort);
+    }
 
-#ifdef _WIN32
-    auto fullscreenStyle = sf::Style::None;
-#else
-    auto fullscreenStyle = sf::Style::Fullscreen;
-#endif
+    // With a DOG_TRACE build, `kill -USR1 <pid>` writes the timeline so far
+    // to --trace; it is written again on exit.
+    TRACE_THREAD("main");
+    if (tracePath != nullptr)
+    {
+        signal(SIGUSR1, on_trace_signal);
+    }
+    signal(SIGINT, on_stop_signal);
+    signal(SIGTERM, on_stop_signal);
 
-    const sf::VideoMode fullScreenMode = sf::VideoMode::getFullscreenModes()[0];
-    const sf::VideoMode windowedMode(1280, 960);
-    bool isFullScreen = false;
+    FrameRecorder recorder;
+    if (recordPath != nullptr && recorder.open(recordPath))
+    {
+        listener.set_recorder(&recorder);
+    }
 
-    astra::StreamSet sensor;
-    astra::StreamReader reader = sensor.create_reader();
+    std::unique_ptr<ClipCapture> clipCapture;
+    if (clipDirectory != nullptr)
+    {
+        clipCapture.reset(new ClipCapture(clipDirectory));
+        listener.set_clip_capture(clipCapture.get());
+    }
 
-    BodyVisualizer listener;
+    // Analysis can run on another machine; "loopback" runs the host in
+    // this process, which exercises the whole link without one.
+    std::atomic<bool> stopOffload{ false };
+    OffloadServer loopbackServer;
+    std::thread loopbackThread;
+    std::unique_ptr<OffloadClient> offload;
+    if (offloadAddress != nullptr)
+    {
+        std::string host = offloadAddress;
+        int port = 7700;
+        if (host == "loopback")
+        {
+            host = "127.0.0.1";
+            if (loopbackServer.open(host.c_str(), port))
+            {
+                loopbackServer.load_model("stgcn_model.bin");
+                loopbackThread = std::thread([&] { loopbackServer.run(stopOffload); });
+            }
+        }
+        else if (host.find(':') != std::string::npos)
+        {
+            port = atoi(host.c_str() + host.find(':') + 1);
+            host.resize(host.find(':'));
+        }
+        offload.reset(new OffloadClient(host, port));
+        offload->set_send_depth(offloadDepth);
+        listener.set_offload(offload.get());
+    }
+    auto shutdown = [&]
+    {
+        finishLoading(true);
+        watchdog.stop();
+        if (rosThread.joinable())
+        {
+            // Unblocks a node still waiting for the master.
+            ros::shutdown();
+            rosThread.join();
+        }
+        if (offload)
+        {
+            offload->print_report();
+        }
+        if (loopbackThread.joinable())
+        {
+            stopOffload = true;
+            loopbackThread.join();
+        }
+        if (tracePath != nullptr) { trace_dump(tracePath); }
+        astra::terminate();
+    };
+
+    if (benchmarking)
+    {
+        if (!replay.is_open())
+        {
+            shutdown();
+            return 1;
+        }
+        // Throughput is measured with the model in place.
+        finishLoading(true);
+        const uint64_t allocationsBefore = listener.metrics().heapAllocations.value();
+        replayDriver.run(replaySink);
+        replayDriver.print_report();
+        listener.arenas().print_report();
+        startup.print_report();
+        int status = 0;
+        if (heap_counting_enabled())
+        {
+            const uint64_t allocations = listener.metrics().heapAllocations.value() - allocationsBefore;
+            printf("Alloc: %llu heap allocations after warm-up\n", static_cast<unsigned long long>(allocations));
+            status = allocations != 0 ? 1 : 0;
+        }
+        shutdown();
+        return status;
+    }
 
-    auto depthStream = configure_depth(reader);
-    depthStream.start();
+    // Headless runs without a window or font, e.g. on the dog itself;
+    // stop it with Ctrl-C or SIGTERM.
+    std::unique_ptr<sf::RenderWindow> window;
+    if (!headless)
+    {
+        window.reset(new sf::RenderWindow(sf::VideoMode(1280, 960), "Simple Body Viewer"));
+        startup.mark("window");
+    }
 
-    auto bodyStream = reader.stream<astra::BodyStream>();
-    bodyStream.start();
-    reader.add_listener(listener);
+    // Depth resolution and tracker accuracy only apply to a live sensor.
+    auto applyQuality = [&](const QualityLevel& level) {
+        listener.set_rendering(level.rendering && !headless);
+        listener.set_model_interval(level.modelInterval);
+        if (replay.is_open()) { return; }
+
+        bodyStream.set_skeleton_optimization(static_cast<astra::SkeletonOptimization>(level.skeletonOptimization));
+        // 160x120 is the sensor's smallest mode.
+        const int divisor = config.depthWidth / level.depthDivisor >= 160 ? level.depthDivisor : 1;
+        set_depth_mode(depthStream, config.depthWidth / divisor, config.depthHeight / divisor, config.depthFps);
+    };
+    if (qualityLevel > 0) { applyQuality(governor.level()); }
+    if (headless) { listener.set_rendering(false); }
 
     //astra::SkeletonProfile profile = bodyStream.get_skeleton_profile();
     astra::SkeletonProfile profile = astra::SkeletonProfile::Full;
     astra::BodyTrackingFeatureFlags features = astra::BodyTrackingFeatureFlags::HandPoses;
 
-    ros::init(argc, argv, "publish_velocity");
-    ros::NodeHandle nh;
-    ros::Publisher pub = nh.advertise<geometry_msgs::Twist>("/cmd_vel", 1000);
     srand(time(0));
-    ros::Rate rate(2);
 
-    while (window.isOpen())
+    // The report waits for the first skeleton, but not forever: with
+    // nobody in view it would never come.
+    bool startupReported = false;
+    bool frameSeen = false;
+    const FrameTime startupReportDeadline = 10000000000LL;
+
+    while (!stopRequested && (headless || window->isOpen()))
     {
 
-        astra_update();
+        if (replay.is_open())
+        {
+            replayDriver.pump(frame_clock_now(), replaySink);
+            if (replayDriver.is_finished() && replayDriver.stats().frames > 0)
+            {
+                replayDriver.print_report();
+                replay.close();
+            }
+        }
+        else
+        {
+            astra_update();
+        }
+        finishLoading(false);
+        if (!watchdog.is_running() && rosReady.load(std::memory_order_acquire))
+        {
+            rosThread.join();
+            watchdog.start(config.cmdVelRate);
+        }
+        if (!startupReported)
+        {
+            if (!frameSeen && listener.metrics().framesReceived.value() > 0)
+            {
+                frameSeen = true;
+                startup.mark("first frame");
+            }
+            if (listener.skeleton_seen())
+            {
+                startup.mark("first skeleton");
+                startup.print_report();
+                startupReported = true;
+            }
+            else if (startup.since_launch() > startupReportDeadline)
+            {
+                startup.print_report();
+                printf("Startup: no skeleton yet\n");
+                startupReported = true;
+            }
+        }
+        if (governed && governor.evaluate(frame_clock_now(), listener.metrics()))
+        {
+            applyQuality(governor.level());
+        }
+        if (configWatcher.changed() && load_config(configPath, config))
+        {
+            printf("Config: reloaded %s\n", configPath);
+            configurePipeline();
+            applyQuality(governor.level());
+        }
+        if (tracePath != nullptr && traceRequested.exchange(false))
+        {
+            trace_dump(tracePath);
+        }
         sf::Event event;
-    double move = 0;
-    double zhuan = 0.0;
-    if(manDis > 2.5) move = 1.0;
-    if(angle>50)	zhuan = 0.3;
-    else if(angle<-50)	zhuan = -0.3;
-    robotMove(move,0,0,0,0,zhuan,pub,rate);
+        {
+            // roscpp serialises every message into a fresh buffer on the
+            // watchdog's thread, so only the hand-over is held to the
+            // no-allocation rule.
+            const AllocationScope decisionAllocations;
+            watchdog.submit(listener.follow_decision(frame_clock_now()));
+            listener.check_allocations(decisionAllocations, "follow decision");
+        }
+        // Publishing no longer paces the loop; keep frames flowing without
+        // spinning.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
-        while (window.pollEvent(event))
+        if (!window)
+        {
+            continue;
+        }
+        while (window->pollEvent(event))
         {
             if (event.type == sf::Event::Closed) {
-                window.close();
+                window->close();
                 break;
             }
             bodyStream.set_skeleton_profile(profile);
@@ -723,10 +1330,12 @@ int main(int argc, char** argv)
 
             //listener.processBodies(reader.get_latest_frame());
         }
-        window.clear(sf::Color::Black);
-        listener.draw_to(window);
-        window.display();
+        window->clear(sf::Color::Black);
+        if (listener.is_rendering()) { listener.draw_to(*window); }
+        window->display();
     }
-    astra::terminate();
+
+    listener.arenas().print_report();
+    shutdown();
     return 0;
 }
@@ -0,0 +1,51 @@
+// Analysis host for the offload link (see OffloadClient.hpp). Runs the
+// same body analysis as the dog, plus the ST-GCN model, on a machine with
+// cycles to spare, and answers each frame with a follow decision.
+//
+// Header-only apart from the standard library and pthreads:
+//
+//   g++ -std=c++14 -O2 -I<sdk>/include offload_server.cpp -pthread
+//       -o offload_server
+//
+// Usage: offload_server [--bind <address>] [--port <port>] [--model <path>]
+//
+// The dog connects with main_demo --offload <host>:<port>.
+
+#include "OffloadServer.hpp"
+#include <csignal>
+#include <cstdlib>
+
+static std::atomic<bool> stopping{ false };
+
+static void on_signal(int)
+{
+    stopping = true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* bind = "0.0.0.0";
+    const char* modelPath = "stgcn_model.bin";
+    int port = 7700;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) { bind = argv[++i]; }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) { port = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) { modelPath = argv[++i]; }
+    }
+
+    OffloadServer server;
+    if (!server.open(bind, port))
+    {
+        return 1;
+    }
+    server.load_model(modelPath);
+    printf("Offload server: listening on %s:%d\n", bind, port);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    server.run(stopping);
+
+    printf("Offload server: %zu frames served\n", server.frames_served());
+    return 0;
+}
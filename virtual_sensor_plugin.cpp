@@ -0,0 +1,325 @@
+// Astra plugin that serves a recording (see Recording.hpp) as if it were a
+// camera, so main_demo runs unmodified without an AstraPro attached.
+//
+// Build it as a shared library next to the SDK's own plugins:
+//
+//   g++ -std=c++14 -O2 -shared -fPIC -I<sdk>/include -L<sdk>/lib
+//       virtual_sensor_plugin.cpp -lastra_core -o libdog_virtual_sensor.so
+//
+// and point astra.toml at a directory holding only this plugin:
+//
+//   [plugins]
+//   path = "VirtualPlugins"
+//
+// Leaving the real sensor and body tracking plugins out of that directory
+// matters: they would register the same stream set, and the recorded
+// bodies are what makes a run reproducible and license-free.
+//
+// Environment:
+//   DOG_VIRTUAL_RECORDING  recording to serve (required)
+//   DOG_VIRTUAL_URI        stream set URI, default "device/default"
+//   DOG_VIRTUAL_SPEED      multiple of real time, 0 = one frame per update
+//   DOG_VIRTUAL_LOOP       non-zero to start over at the end
+
+#include <astra_core/plugins/Plugin.hpp>
+#include <astra/capi/astra_ctypes.h>
+#include <astra/capi/streams/stream_types.h>
+#include <astra/capi/streams/body_parameters.h>
+#include <astra/capi/streams/depth_parameters.h>
+#include <astra/capi/streams/image_parameters.h>
+#include "Recording.hpp"
+#include "ReplayDriver.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+
+// Exported by libastra_core; the SDK ships without the header declaring them.
+namespace astra {
+    extern const int MajorVersion;
+    extern const int MinorVersion;
+    extern const int PatchVersion;
+    extern const int ApiLevel;
+    extern const char* VersionSuffix;
+    extern const char* GitSha;
+    extern const char* FriendlyName;
+}
+
+namespace dog {
+
+    const char* const kChannel = "dog.virtual_sensor";
+
+    // Same field of view DepthFallbackTracker assumes for the AstraPro.
+    const float kHorizontalFov = 1.0472f;
+    const float kVerticalFov = 0.8639f;
+
+    template<typename T>
+    astra_status_t write_parameter(astra::PluginServiceProxy& pluginService,
+                                   astra_parameter_bin_t& parameterBin,
+                                   const T* values, size_t count = 1)
+    {
+        astra_parameter_data_t data;
+        const uint32_t size = static_cast<uint32_t>(count * sizeof(T));
+        const astra_status_t status = pluginService.get_parameter_bin(size, &parameterBin, &data);
+        if (status == ASTRA_STATUS_SUCCESS)
+        {
+            std::memcpy(data, values, size);
+        }
+        return status;
+    }
+
+    class depth_stream : public astra::plugins::single_bin_stream<astra_imageframe_wrapper_t>
+    {
+    public:
+        depth_stream(astra::PluginServiceProxy& pluginService,
+                     astra_streamset_t streamSet,
+                     int width, int height)
+            : single_bin_stream(pluginService,
+                                streamSet,
+                                astra::StreamDescription(ASTRA_STREAM_DEPTH, DEFAULT_SUBTYPE),
+                                width * height * sizeof(int16_t)),
+              width_(width),
+              height_(height)
+        {
+            mode_.id = 0;
+            mode_.width = width;
+            mode_.height = height;
+            mode_.pixelFormat = ASTRA_PIXEL_FORMAT_DEPTH_MM;
+            mode_.fps = 30;
+        }
+
+        void publish(const DepthView& depth)
+        {
+            if (!has_started_connections() || depth.width != width_ || depth.height != height_) { return; }
+
+            astra_imageframe_wrapper_t* wrapper = begin_write(depth.frameIndex);
+            if (wrapper == nullptr) { return; }
+
+            wrapper->frame.frame = nullptr;
+            wrapper->frame.data = &wrapper->frame_data;
+            wrapper->frame.metadata.width = width_;
+            wrapper->frame.metadata.height = height_;
+            wrapper->frame.metadata.pixelFormat = ASTRA_PIXEL_FORMAT_DEPTH_MM;
+            std::memcpy(wrapper->frame_data, depth.data, width_ * height_ * sizeof(int16_t));
+            end_write();
+        }
+
+    protected:
+        astra_status_t on_set_parameter(astra_streamconnection_t /*connection*/,
+                                        astra_parameter_id id,
+                                        std::uint32_t inByteLength,
+                                        astra_parameter_data_t inData) override
+        {
+            switch (id) {
+            case ASTRA_PARAMETER_IMAGE_MODE:
+            {
+                // Only the recorded mode exists; asking for another one is
+                // not an error for the application, it just gets this one.
+                if (inByteLength >= sizeof(astra_imagestream_mode_t))
+                {
+                    const astra_imagestream_mode_t* mode = static_cast<const astra_imagestream_mode_t*>(inData);
+                    if (mode->width != mode_.width || mode->height != mode_.height)
+                    {
+                        LOG_WARN(kChannel, "requested %ux%u, recording is %ux%u",
+                                 mode->width, mode->height, mode_.width, mode_.height);
+                    }
+                }
+                return ASTRA_STATUS_SUCCESS;
+            }
+            case ASTRA_PARAMETER_IMAGE_MIRRORING:
+            case ASTRA_PARAMETER_DEPTH_REGISTRATION:
+                return ASTRA_STATUS_SUCCESS;
+            default:
+                return ASTRA_STATUS_INVALID_OPERATION;
+            }
+        }
+
+        astra_status_t on_get_parameter(astra_streamconnection_t /*connection*/,
+                                        astra_parameter_id id,
+                                        astra_parameter_bin_t& parameterBin) override
+        {
+            switch (id) {
+            case ASTRA_PARAMETER_IMAGE_HFOV:
+                return write_parameter(pluginService(), parameterBin, &kHorizontalFov);
+            case ASTRA_PARAMETER_IMAGE_VFOV:
+                return write_parameter(pluginService(), parameterBin, &kVerticalFov);
+            case ASTRA_PARAMETER_IMAGE_MIRRORING:
+            {
+                const bool mirroring = false;
+                return write_parameter(pluginService(), parameterBin, &mirroring);
+            }
+            case ASTRA_PARAMETER_IMAGE_MODE:
+            case ASTRA_PARAMETER_IMAGE_AVAILABLE_MODES:
+                return write_parameter(pluginService(), parameterBin, &mode_);
+            case ASTRA_PARAMETER_DEPTH_CONVERSION_CACHE:
+            {
+                astra_conversion_cache_t cache;
+                cache.xzFactor = std::tan(kHorizontalFov / 2.f) * 2.f;
+                cache.yzFactor = std::tan(kVerticalFov / 2.f) * 2.f;
+                cache.resolutionX = width_;
+                cache.resolutionY = height_;
+                cache.halfResX = width_ / 2;
+                cache.halfResY = height_ / 2;
+                cache.coeffX = width_ / cache.xzFactor;
+                cache.coeffY = height_ / cache.yzFactor;
+                return write_parameter(pluginService(), parameterBin, &cache);
+            }
+            default:
+                return ASTRA_STATUS_INVALID_OPERATION;
+            }
+        }
+
+    private:
+        int width_;
+        int height_;
+        astra_imagestream_mode_t mode_;
+    };
+
+    // Serves the bodies, floor and masks that were tracked when the
+    // recording was made; nothing is re-tracked.
+    class body_stream : public astra::plugins::single_bin_stream<astra_bodyframe_wrapper_t>
+    {
+    public:
+        body_stream(astra::PluginServiceProxy& pluginService,
+                    astra_streamset_t streamSet)
+            : single_bin_stream(pluginService,
+                                streamSet,
+                                astra::StreamDescription(ASTRA_STREAM_BODY, DEFAULT_SUBTYPE),
+                                0)
+        { }
+
+        void publish(const BodyFrameView& body)
+        {
+            if (!has_started_connections() || !body.valid) { return; }
+
+            astra_bodyframe_wrapper_t* wrapper = begin_write(body.frameIndex);
+            if (wrapper == nullptr) { return; }
+
+            _astra_bodyframe& frame = wrapper->frame;
+            frame.frame = nullptr;
+            frame.info.width = body.width;
+            frame.info.height = body.height;
+            frame.info.isEstimated = 0;
+
+            const int count = std::min(body.count, static_cast<int>(ASTRA_MAX_BODIES));
+            std::memcpy(frame.bodyList.bodies, body.bodies, count * sizeof(astra_body_t));
+            frame.bodyList.count = count;
+
+            frame.floorInfo.floorPlane = body.floorPlane;
+            frame.floorInfo.floorDetected = body.floorDetected ? ASTRA_TRUE : ASTRA_FALSE;
+
+            const int maskBytes = body.maskWidth * body.maskHeight;
+            if (body.bodyMask != nullptr && maskBytes <= ASTRA_TEMP_IMAGE_LENGTH)
+            {
+                std::memcpy(frame.bodyMask.data, body.bodyMask, maskBytes);
+                std::memcpy(frame.floorInfo.floorMask.data, body.floorMask, maskBytes);
+                frame.bodyMask.width = frame.floorInfo.floorMask.width = body.maskWidth;
+                frame.bodyMask.height = frame.floorInfo.floorMask.height = body.maskHeight;
+            }
+            else
+            {
+                frame.bodyMask.width = frame.floorInfo.floorMask.width = 0;
+                frame.bodyMask.height = frame.floorInfo.floorMask.height = 0;
+            }
+            end_write();
+        }
+
+    protected:
+        // Tracking options are meaningless for recorded bodies; accept them
+        // so the application's setup calls succeed.
+        astra_status_t on_set_parameter(astra_streamconnection_t /*connection*/,
+                                        astra_parameter_id id,
+                                        std::uint32_t /*inByteLength*/,
+                                        astra_parameter_data_t /*inData*/) override
+        {
+            switch (id) {
+            case ASTRA_PARAMETER_BODY_DEFAULT_BODY_FEATURES:
+            case ASTRA_PARAMETER_BODY_SKELETON_PROFILE:
+            case ASTRA_PARAMETER_BODY_SKELETON_OPTIMIZATION:
+            case ASTRA_PARAMETER_BODY_ORIENTATION:
+                return ASTRA_STATUS_SUCCESS;
+            default:
+                return ASTRA_STATUS_INVALID_OPERATION;
+            }
+        }
+    };
+
+    class virtual_sensor_plugin : public astra::plugins::plugin_base
+    {
+    public:
+        virtual_sensor_plugin(astra::PluginServiceProxy* pluginProxy)
+            : plugin_base(pluginProxy, "dog_virtual_sensor")
+        {
+            const char* path = std::getenv("DOG_VIRTUAL_RECORDING");
+            const char* uri = std::getenv("DOG_VIRTUAL_URI");
+            const char* speed = std::getenv("DOG_VIRTUAL_SPEED");
+            const char* loop = std::getenv("DOG_VIRTUAL_LOOP");
+
+            loop_ = loop != nullptr && std::atoi(loop) != 0;
+            if (path == nullptr || !recording_.open(path))
+            {
+                LOG_ERROR(kChannel, "no recording to serve, set DOG_VIRTUAL_RECORDING");
+                return;
+            }
+
+            FrameRef first;
+            size_t i = 0;
+            while (i < recording_.frame_count() && !(recording_.frame(i, first) && first.depth.is_valid())) { i++; }
+            if (i == recording_.frame_count())
+            {
+                LOG_ERROR(kChannel, "%s has no depth frames", path);
+                recording_.close();
+                return;
+            }
+
+            pluginService().create_stream_set(uri != nullptr ? uri : "device/default", streamSet_);
+            depthStream_.reset(astra::plugins::make_stream<depth_stream>(
+                pluginService(), streamSet_, first.depth.width, first.depth.height));
+            bodyStream_.reset(astra::plugins::make_stream<body_stream>(pluginService(), streamSet_));
+
+            driver_ = astra::make_unique<ReplayDriver>(recording_, speed != nullptr ? std::atof(speed) : 1.0);
+            driver_->start(0, frame_clock_now());
+            LOG_INFO(kChannel, "serving %zu frames from %s", recording_.frame_count(), path);
+        }
+
+        ~virtual_sensor_plugin()
+        {
+            driver_ = nullptr;
+            bodyStream_ = nullptr;
+            depthStream_ = nullptr;
+            if (streamSet_ != nullptr)
+            {
+                pluginService().destroy_stream_set(streamSet_);
+            }
+        }
+
+        // Called from astra_update(). Unthrottled, each update delivers a
+        // single frame so the application sees every one of them.
+        void update() override
+        {
+            if (driver_ == nullptr) { return; }
+
+            if (driver_->is_finished())
+            {
+                if (!loop_) { return; }
+                driver_->start(0, frame_clock_now());
+            }
+
+            auto sink = [this](const FrameRef& frame)
+            {
+                depthStream_->publish(frame.depth);
+                bodyStream_->publish(frame.body);
+            };
+            driver_->pump(frame_clock_now(), sink, 0);
+        }
+
+    private:
+        MappedRecording recording_;
+        std::unique_ptr<ReplayDriver> driver_;
+        bool loop_{ false };
+        astra_streamset_t streamSet_{ nullptr };
+        std::unique_ptr<depth_stream> depthStream_;
+        std::unique_ptr<body_stream> bodyStream_;
+    };
+}
+
+EXPORT_PLUGIN(dog::virtual_sensor_plugin);